@@ -0,0 +1,548 @@
+//
+//  benchmark.cpp
+//  InvincibleSummer
+//
+
+#include "benchmark.h"
+#include "search.h"
+#include "hw_counters.h"
+#include "dedup.h"
+#include "dfpn.h"
+#include "notation.h"
+#include "large_pages.h"
+#include "movecache.h"
+#include "polyglot.h"
+#include "tablebase.h"
+#include "utility.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+const std::vector<std::string> bench_positions = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "r2q1rk1/ppp2ppp/2n1bn2/2bpp3/4P3/2PP1NP1/PP1N1PBP/R1BQ1RK1 w - - 0 8",
+    "2r2rk1/pp3ppp/2n1p3/3pP3/3P4/P4N2/1P3PPP/2R2RK1 w - - 0 20",
+    "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1",
+};
+
+void smp_speedup_benchmark(int depth, int threads, size_t hash_megabytes){
+    Searcher searcher;
+    searcher.set_hash(hash_megabytes);
+    search_limits limits;
+    limits.depth = depth;
+
+    double total_single = 0, total_multi = 0;
+    U64 nodes_single = 0, nodes_multi = 0;
+    for(size_t i = 0; i < bench_positions.size(); i++){
+        Bitboard_Gen board(bench_positions[i]);
+        searcher.set_threads(1);
+        searcher.clear();
+        search_result single = searcher.search(board, limits);
+        searcher.set_threads(threads);
+        searcher.clear();
+        search_result multi = searcher.search(board, limits);
+
+        total_single += single.time;
+        total_multi += multi.time;
+        nodes_single += single.nodes;
+        nodes_multi += multi.nodes;
+        std::cout << "position " << i + 1 << ": depth " << multi.depth
+                  << "  1 thread " << single.time << " ms " << single.nps << " nps"
+                  << "  " << threads << " threads " << multi.time << " ms " << multi.nps << " nps"
+                  << "  speedup " << std::fixed << std::setprecision(2)
+                  << (double) (single.time ? single.time : 1) / (multi.time ? multi.time : 1) << std::endl;
+    }
+    std::cout << "total 1 thread " << (U64) total_single << " ms " << nodes_single << " nodes"
+              << ", " << threads << " threads " << (U64) total_multi << " ms " << nodes_multi << " nodes"
+              << ", time to depth speedup " << std::fixed << std::setprecision(2)
+              << (total_single ? total_single : 1) / (total_multi ? total_multi : 1) << std::endl;
+}
+
+//opens the counters if asked to, saying why when the kernel refuses
+static Hardware_Counters * open_counters(bool counters){
+    if(!counters)
+        return nullptr;
+    Hardware_Counters * hardware = new Hardware_Counters();
+    if(!hardware->error().empty())
+        std::cout << "hardware counters: " << (hardware->available() ? "skipping " : "unavailable, ") << hardware->error() << std::endl;
+    if(!hardware->available()){
+        delete hardware;
+        return nullptr;
+    }
+    return hardware;
+}
+
+static std::string per_node(const hw_sample & sample, U64 nodes){
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2);
+    for(int i = 0; i < HW_NUM_COUNTERS; i++){
+        if(sample.valid[i])
+            line << "  " << Hardware_Counters::name(i) << "/node " << (double) sample.values[i] / (nodes ? nodes : 1);
+    }
+    if(sample.valid[HW_CYCLES] && sample.valid[HW_INSTRUCTIONS] && sample.values[HW_CYCLES])
+        line << "  ipc " << (double) sample.values[HW_INSTRUCTIONS] / sample.values[HW_CYCLES];
+    return line.str();
+}
+
+U64 search_benchmark(int depth, bool counters){
+    Searcher searcher;
+    searcher.set_hash(16);
+    search_limits limits;
+    limits.depth = depth;
+    std::unique_ptr<Hardware_Counters> hardware(open_counters(counters));
+
+    U64 nodes = 0, qnodes = 0;
+    int64_t time = 0;
+    for(size_t i = 0; i < bench_positions.size(); i++){
+        Bitboard_Gen board(bench_positions[i]);
+        if(hardware)
+            hardware->start();
+        search_result result = searcher.search(board, limits);
+        std::cout << "position " << i + 1 << ": " << result.nodes << " nodes, qsearch "
+                  << std::fixed << std::setprecision(1) << 100.0 * result.qnodes / (result.nodes ? result.nodes : 1) << "%";
+        if(hardware)
+            std::cout << per_node(hardware->stop(), result.nodes);
+        std::cout << std::endl;
+        nodes += result.nodes;
+        qnodes += result.qnodes;
+        time += result.time;
+    }
+    std::cout << "\nNodes searched: " << nodes << "\nQsearch nodes: " << qnodes << " (" << std::fixed << std::setprecision(1)
+              << 100.0 * qnodes / (nodes ? nodes : 1) << "%)" << "\nNodes/second: " << nodes * 1000 / (time ? time : 1) << std::endl;
+    return nodes;
+}
+
+U64 perft_benchmark(int depth, bool counters){
+    std::unique_ptr<Hardware_Counters> hardware(open_counters(counters));
+
+    U64 nodes = 0;
+    int64_t time = 0;
+    for(size_t i = 0; i < bench_positions.size(); i++){
+        Bitboard_Gen board(bench_positions[i]);
+        auto start = std::chrono::steady_clock::now();
+        if(hardware)
+            hardware->start();
+        U64 position_nodes = board.perft(depth);
+        hw_sample sample;
+        if(hardware)
+            sample = hardware->stop();
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "position " << i + 1 << ": " << position_nodes << " nodes " << position_nodes * 1000 / (elapsed ? elapsed : 1) << " nps";
+        if(hardware)
+            std::cout << per_node(sample, position_nodes);
+        std::cout << std::endl;
+        nodes += position_nodes;
+        time += elapsed;
+    }
+    std::cout << "\nNodes searched: " << nodes << "\nNodes/second: " << nodes * 1000 / (time ? time : 1) << std::endl;
+    return nodes;
+}
+
+void dedup_benchmark(U64 positions, size_t megabytes, int threads){
+    //every position of short random games from the bench positions, early ones repeat a lot
+    std::vector<std::pair<U64, U64>> stream;
+    stream.reserve(positions);
+    PRNG rng(1070372);
+    while(stream.size() < positions){
+        Bitboard_Gen board(bench_positions[rng.rand64() % bench_positions.size()]);
+        int length = 1 + (int) (rng.rand64() % 24);
+        for(int ply = 0; ply < length && stream.size() < positions; ply++){
+            stream.emplace_back(board.zobrist_hash, secondary_key(board));
+            uint16_t move_list[256];
+            int num_moves = board.generate_moves(move_list);
+            int legal = 0;
+            for(int i = 0; i < num_moves; i++){
+                board.make_move(move_list[i]);
+                if(!board.is_move_legal())
+                    move_list[legal++] = move_list[i];
+                board.unmake_move(move_list[i]);
+            }
+            if(!legal)
+                break;
+            board.make_move(move_list[rng.rand64() % legal]);
+        }
+    }
+    std::vector<std::pair<U64, U64>> distinct(stream);
+    std::sort(distinct.begin(), distinct.end());
+    U64 unique = std::unique(distinct.begin(), distinct.end()) - distinct.begin();
+    distinct = std::vector<std::pair<U64, U64>>();
+
+    Position_Filter filter(megabytes);
+    std::atomic<U64> reported{0};
+    std::atomic<size_t> next{0};
+    auto start = std::chrono::steady_clock::now();
+    auto worker = [&](){
+        const size_t chunk = 4096;
+        U64 duplicates = 0;
+        for(size_t begin = next.fetch_add(chunk); begin < stream.size(); begin = next.fetch_add(chunk)){
+            for(size_t i = begin; i < std::min(begin + chunk, stream.size()); i++)
+                duplicates += filter.test_and_insert(stream[i].first, stream[i].second);
+        }
+        reported.fetch_add(duplicates);
+    };
+    std::vector<std::thread> pool;
+    for(int i = 1; i < threads; i++)
+        pool.emplace_back(worker);
+    worker();
+    for(auto & thread : pool)
+        thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    //new positions reported as seen, a race between two copies can push this below zero
+    U64 true_duplicates = stream.size() - unique;
+    double false_positives = (double) reported.load() - (double) true_duplicates;
+    std::cout << std::fixed << std::setprecision(2)
+              << "positions " << stream.size() << ", distinct " << unique
+              << ", duplicates " << 100.0 * true_duplicates / stream.size() << "%"
+              << "\nfilter " << filter.memory() / (1024 * 1024) << " MB, " << threads << " threads, "
+              << stream.size() / (seconds > 0 ? seconds : 1e-9) / 1e6 << " million positions/second"
+              << std::scientific << std::setprecision(3)
+              << "\nfalse positive rate " << std::max(0.0, false_positives) / (unique ? unique : 1)
+              << " over the stream, " << filter.expected_false_positive_rate() << " expected at the final load" << std::endl;
+}
+
+//mates by continuous checks with the number of moves to mate, 0 when checks alone do not mate
+static const std::vector<std::pair<std::string, int>> mate_positions = {
+    {"6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", 1},
+    {"r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4", 1},
+    {"6rk/6pp/8/6N1/8/8/8/6K1 w - - 0 1", 1},
+    {"4k3/8/4K3/8/8/8/8/7R w - - 0 1", 1},
+    {"r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1", 2},
+    {"6k1/pp4p1/2p5/2bp4/8/P5Pb/1P3rrP/2BRRN1K b - - 0 1", 2},
+    {"r1bq2r1/b4pk1/p1pp1p2/1p2pP2/1P2P1PB/3P4/1PPQ2P1/R3K2R w - - 0 1", 2},
+    {"r1b1kb1r/pppp1ppp/5q2/4n3/3KP3/2N3PN/PPP4P/R1BQ1B1R b kq - 0 1", 3},
+    {"2r3k1/p4p2/3Rp2p/1p2P1pK/8/1P4P1/P3Q2P/1q6 b - - 0 1", 3},
+    {"r6k/6pp/8/4N3/8/1Q6/8/6K1 w - - 0 1", 4},
+    {"7k/8/8/8/8/8/R7/1R4K1 w - - 0 1", 0},
+};
+
+void mate_benchmark(U64 max_nodes, size_t megabytes){
+    DFPN_Solver solver(megabytes);
+    U64 nodes = 0;
+    double seconds = 0;
+    int solved = 0;
+    for(size_t i = 0; i < mate_positions.size(); i++){
+        Bitboard_Gen board(mate_positions[i].first);
+        int expected = mate_positions[i].second;
+        solver.clear();
+        //a ply limit of the expected length keeps the search from chasing longer checking lines
+        dfpn_result result = solver.solve(board, max_nodes, 2 * expected - 1);
+        int found = result.status == DFPN_PROVEN ? (result.mate_plies + 1) / 2 : 0;
+        bool correct = expected ? found == expected : result.status == DFPN_DISPROVEN;
+        solved += correct;
+        nodes += result.nodes;
+        seconds += result.seconds;
+        std::cout << "position " << i + 1 << ": " << (expected ? "mate in " + std::to_string(expected) : std::string("no mate")) << " "
+                  << (correct ? "solved" : result.status == DFPN_UNKNOWN ? "unknown" : "missed")
+                  << " " << result.nodes << " nodes " << std::fixed << std::setprecision(3) << result.seconds * 1000 << " ms "
+                  << (U64) (result.nodes / (result.seconds > 0 ? result.seconds : 1e-9)) << " nps" << std::endl;
+    }
+    std::cout << "\nSolved: " << solved << "/" << mate_positions.size()
+              << "\nNodes searched: " << nodes
+              << "\nTime to proof: " << std::fixed << std::setprecision(3) << seconds * 1000 << " ms"
+              << "\nNodes/second: " << (U64) (nodes / (seconds > 0 ? seconds : 1e-9)) << std::endl;
+}
+
+//KPvKP positions whose result depends on en passant, with the result for the side to move
+static const std::vector<std::pair<std::string, int>> tablebase_positions = {
+    //a2-a4 is met only by bxa3 e.p., every other reply loses
+    {"8/8/8/8/1p6/6k1/P7/K7 w - - 0 1", TB_DRAW},
+    //h7-h5 is met only by gxh6 e.p.
+    {"7k/7p/8/6P1/8/8/8/K7 b - - 0 1", TB_DRAW},
+};
+
+void tablebase_benchmark(const std::string & directory, int threads){
+    Tablebase tablebase;
+    tablebase.load_directory(directory);
+    auto start = std::chrono::steady_clock::now();
+    if(!tablebase.build("KPvKP", directory, threads)){
+        std::cout << "could not build KPvKP in " << directory << std::endl;
+        return;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    static const char * results[4] = {"draw", "win", "loss", "invalid"};
+    int correct = 0;
+    for(size_t i = 0; i < tablebase_positions.size(); i++){
+        Bitboard_Gen board(tablebase_positions[i].first);
+        int wdl = TB_INVALID, dtm = 0;
+        bool found = tablebase.probe(board, wdl, dtm);
+        correct += found && wdl == tablebase_positions[i].second;
+        std::cout << "position " << i + 1 << ": expected " << results[tablebase_positions[i].second] << ", "
+                  << (found ? std::string(results[wdl]) + (wdl == TB_WIN || wdl == TB_LOSS ? " in " + std::to_string(dtm) + " plies" : "") : std::string("no table"))
+                  << std::endl;
+    }
+    std::cout << "\nCorrect: " << correct << "/" << tablebase_positions.size()
+              << "\nBuild time: " << std::fixed << std::setprecision(1) << seconds << " s" << std::endl;
+}
+
+//moves from the start position and the key the Polyglot format description gives
+static const std::vector<std::pair<std::string, U64>> polyglot_positions = {
+    {"", 0x463b96181691fc9cULL},
+    {"e2e4", 0x823c9b50fd114196ULL},
+    {"e2e4 d7d5", 0x0756b94461c50fb0ULL},
+    {"e2e4 d7d5 e4e5", 0x662fafb965db29d4ULL},
+    //f5 can be taken en passant, the file is hashed
+    {"e2e4 d7d5 e4e5 f7f5", 0x22a48b5a8e47ff78ULL},
+    {"e2e4 d7d5 e4e5 f7f5 e1e2", 0x652a607ca3f242c1ULL},
+    {"e2e4 d7d5 e4e5 f7f5 e1e2 e8f7", 0x00fdd303c946bdd9ULL},
+    //c4 can be taken en passant by b4
+    {"a2a4 b7b5 h2h4 b5b4 c2c4", 0x3c8123ea7b067637ULL},
+    {"a2a4 b7b5 h2h4 b5b4 c2c4 b4c3 a1a3", 0x5c3f9b829b279560ULL},
+};
+
+void polyglot_benchmark(int rounds){
+    Polyglot_Book book;
+    std::vector<std::unique_ptr<Bitboard_Gen>> boards;
+    int correct = 0;
+    for(size_t i = 0; i < polyglot_positions.size(); i++){
+        boards.emplace_back(new Bitboard_Gen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"));
+        Bitboard_Gen & board = *boards.back();
+        std::istringstream moves(polyglot_positions[i].first);
+        std::string text;
+        while(moves >> text)
+            board.make_move(from_uci(board, text.c_str()));
+        U64 key = book.key(board);
+        correct += key == polyglot_positions[i].second;
+        std::cout << "position " << i + 1 << ": " << std::hex << std::setfill('0') << std::setw(16) << key;
+        if(key == polyglot_positions[i].second)
+            std::cout << " ok";
+        else
+            std::cout << " expected " << std::setw(16) << polyglot_positions[i].second;
+        std::cout << std::dec << std::setfill(' ') << std::endl;
+    }
+
+    U64 checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(int round = 0; round < rounds; round++){
+        for(auto & board : boards)
+            checksum ^= book.key(*board) + round;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double keys = (double) rounds * boards.size();
+    std::cout << "\nCorrect: " << correct << "/" << polyglot_positions.size()
+              << "\nKeys/s: " << (U64) (keys / std::max(seconds, 1e-9))
+              << "\nChecksum: " << checksum << std::endl;
+}
+
+void notation_benchmark(int rounds){
+    //the legal moves of every bench position and of a few random positions after each
+    std::vector<std::unique_ptr<Bitboard_Gen>> boards;
+    std::vector<std::vector<uint16_t>> moves;
+    PRNG rng(1070372);
+    for(const std::string & fen : bench_positions){
+        for(int game = 0; game < 4; game++){
+            boards.emplace_back(new Bitboard_Gen(fen));
+            Bitboard_Gen & board = *boards.back();
+            for(int ply = 0; ply < game * 6; ply++){
+                uint16_t move_list[256];
+                int num_moves = board.generate_moves(move_list);
+                int legal = 0;
+                for(int i = 0; i < num_moves; i++){
+                    board.make_move(move_list[i]);
+                    if(!board.is_move_legal())
+                        move_list[legal++] = move_list[i];
+                    board.unmake_move(move_list[i]);
+                }
+                if(!legal)
+                    break;
+                board.make_move(move_list[rng.rand64() % legal]);
+            }
+            moves.emplace_back();
+            uint16_t move_list[256];
+            int num_moves = board.generate_moves(move_list);
+            for(int i = 0; i < num_moves; i++){
+                board.make_move(move_list[i]);
+                if(!board.is_move_legal())
+                    moves.back().push_back(move_list[i]);
+                board.unmake_move(move_list[i]);
+            }
+        }
+    }
+
+    //each function in its own timed loop, the readers on text the writers made
+    struct move_text{
+        char uci[MOVE_TEXT_SIZE];
+        char san[MOVE_TEXT_SIZE];
+    };
+    std::vector<std::vector<move_text>> texts(boards.size());
+    U64 count = 0, errors = 0, checksum = 0;
+    for(size_t b = 0; b < boards.size(); b++){
+        texts[b].resize(moves[b].size());
+        for(size_t i = 0; i < moves[b].size(); i++){
+            to_uci(moves[b][i], texts[b][i].uci);
+            to_san(*boards[b], moves[b][i], texts[b][i].san);
+        }
+        count += moves[b].size();
+    }
+    count *= rounds;
+    double seconds[4];
+    for(int function = 0; function < 4; function++){
+        char text[MOVE_TEXT_SIZE];
+        auto start = std::chrono::steady_clock::now();
+        for(int round = 0; round < rounds; round++){
+            for(size_t b = 0; b < boards.size(); b++){
+                Bitboard_Gen & board = *boards[b];
+                for(size_t i = 0; i < moves[b].size(); i++){
+                    uint16_t move = moves[b][i];
+                    if(function == 0) checksum += to_uci(move, text) + text[3];
+                    else if(function == 1) errors += from_uci(board, texts[b][i].uci) != move;
+                    else if(function == 2) checksum += to_san(board, move, text) + text[1];
+                    else errors += from_san(board, texts[b][i].san) != move;
+                }
+            }
+        }
+        seconds[function] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    const char * names[4] = {"to_uci", "from_uci", "to_san", "from_san"};
+    std::cout << count / rounds << " moves from " << boards.size() << " positions, " << errors << " round trip errors" << std::endl;
+    for(int i = 0; i < 4; i++)
+        std::cout << std::left << std::setw(9) << names[i] << std::right << std::fixed << std::setprecision(2)
+                  << count / (seconds[i] > 0 ? seconds[i] : 1e-9) / 1e6 << " million moves/second" << std::endl;
+    std::cout << "checksum " << checksum << std::endl;
+}
+
+void large_pages_benchmark(size_t megabytes, U64 probes, int depth){
+    bool was_enabled = large_pages_enabled();
+    std::unique_ptr<Hardware_Counters> hardware(open_counters(true));
+    double probe_ns[2] = {}, search_nps[2] = {};
+    for(int enabled = 0; enabled < 2; enabled++){
+        set_large_pages(enabled);
+        //random keys, so nearly every probe lands on a page the last one did not
+        Transposition_Table table(megabytes);
+        PRNG rng(1070372);
+        for(U64 i = 0; i < probes / 4; i++)
+            table.store(rng.rand64(), (uint16_t) i, 0, 0, (int) (i & 31), TT_BOUND_EXACT);
+        //the same keys again, a quarter of the probes find their entry
+        rng = PRNG(1070372);
+        U64 hits = 0;
+        tt_data entry;
+        if(hardware)
+            hardware->start();
+        auto start = std::chrono::steady_clock::now();
+        for(U64 i = 0; i < probes; i++)
+            hits += table.probe(rng.rand64(), entry);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        probe_ns[enabled] = seconds * 1e9 / (probes ? probes : 1);
+        std::cout << (enabled ? "large pages on: " : "large pages off: ") << megabytes << " MB table on " << table.page_kind_name()
+                  << ", " << std::fixed << std::setprecision(1) << probe_ns[enabled] << " ns/probe";
+        if(hardware)
+            std::cout << per_node(hardware->stop(), probes);
+        std::cout << " (" << hits << " hits)" << std::endl;
+
+        //the same table size under the search, counters per node
+        Searcher searcher;
+        searcher.set_hash(megabytes);
+        search_limits limits;
+        limits.depth = depth;
+        U64 nodes = 0;
+        int64_t time = 0;
+        if(hardware)
+            hardware->start();
+        for(const std::string & fen : bench_positions){
+            Bitboard_Gen board(fen);
+            search_result result = searcher.search(board, limits);
+            nodes += result.nodes;
+            time += result.time;
+        }
+        search_nps[enabled] = (double) nodes * 1000 / (time ? time : 1);
+        std::cout << "  search depth " << depth << ": " << nodes << " nodes " << (U64) search_nps[enabled] << " nps";
+        if(hardware)
+            std::cout << per_node(hardware->stop(), nodes);
+        std::cout << std::endl;
+    }
+    set_large_pages(was_enabled);
+    std::cout << "\nProbe speedup: " << std::fixed << std::setprecision(2) << probe_ns[0] / (probe_ns[1] > 0 ? probe_ns[1] : 1)
+              << "\nSearch nps speedup: " << search_nps[1] / (search_nps[0] > 0 ? search_nps[0] : 1) << std::endl;
+}
+
+void move_cache_benchmark(size_t megabytes, U64 queries){
+    //random games from the bench positions, kept as the start and the moves played
+    struct game{
+        std::string fen;
+        std::vector<uint16_t> moves;
+    };
+    std::vector<game> games;
+    PRNG rng(1070372);
+    for(const std::string & fen : bench_positions){
+        for(int i = 0; i < 8; i++){
+            games.push_back({fen, {}});
+            Bitboard_Gen board(fen);
+            for(int ply = 0; ply < 80; ply++){
+                uint16_t move_list[256];
+                int num_moves = board.generate_moves(move_list);
+                int legal = 0;
+                for(int j = 0; j < num_moves; j++){
+                    board.make_move(move_list[j]);
+                    if(!board.is_move_legal())
+                        move_list[legal++] = move_list[j];
+                    board.unmake_move(move_list[j]);
+                }
+                if(!legal)
+                    break;
+                games.back().moves.push_back(move_list[rng.rand64() % legal]);
+                board.make_move(games.back().moves.back());
+            }
+        }
+    }
+
+    //a viewer stepping forward and back through a game, now and then opening another,
+    //asking for the legal moves and check status after every step
+    double seconds[2] = {};
+    for(int cached = 0; cached < 2; cached++){
+        std::unique_ptr<Move_Cache> cache(cached ? new Move_Cache(megabytes) : nullptr);
+        PRNG walk(1070372);
+        Bitboard_Gen board(games[0].fen);
+        size_t current = 0, cursor = 0;
+        U64 checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for(U64 i = 0; i < queries; i++){
+            U64 step = walk.rand64() % 100;
+            if(step < 2){
+                current = walk.rand64() % games.size();
+                cursor = 0;
+                board.set_board(games[current].fen);
+            }else if(step < 60 && cursor < games[current].moves.size()){
+                board.make_move(games[current].moves[cursor++]);
+            }else if(cursor){
+                board.unmake_move(games[current].moves[--cursor]);
+            }
+            uint16_t move_list[256];
+            bool in_check;
+            int legal = 0;
+            if(cache){
+                legal = cache->legal_moves(board, move_list, in_check);
+            }else{
+                int num_moves = board.generate_moves(move_list);
+                for(int j = 0; j < num_moves; j++){
+                    board.make_move(move_list[j]);
+                    if(!board.is_move_legal())
+                        move_list[legal++] = move_list[j];
+                    board.unmake_move(move_list[j]);
+                }
+                in_check = board.position_in_check();
+            }
+            checksum += legal + in_check;
+        }
+        seconds[cached] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << (cached ? "with cache: " : "without cache: ") << (U64) (queries / (seconds[cached] > 0 ? seconds[cached] : 1e-9))
+                  << " queries/s, checksum " << checksum;
+        if(cache){
+            move_cache_stats stats = cache->stats();
+            std::cout << ", " << cache->memory() / 1024 << " KB, hit rate " << std::fixed << std::setprecision(1) << 100 * stats.hit_rate()
+                      << "%, " << stats.entries << " of " << stats.capacity << " entries, " << stats.evictions << " evictions, "
+                      << stats.skipped << " lists too long";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "\nSpeedup: " << std::fixed << std::setprecision(2) << seconds[0] / (seconds[1] > 0 ? seconds[1] : 1e-9) << std::endl;
+}
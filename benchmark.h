@@ -0,0 +1,60 @@
+//
+//  benchmark.h
+//  InvincibleSummer
+//
+//  Fixed position sets and timing harnesses for regression tracking.
+//
+#include "bitboard_gen.h"
+#include <string>
+#include <vector>
+
+#ifndef BENCHMARK
+#define BENCHMARK
+
+extern const std::vector<std::string> bench_positions;
+
+//searches every bench position to a fixed depth with one thread and then with
+//threads, printing time to depth, nodes and nps for both and the speedup
+void smp_speedup_benchmark(int depth, int threads, size_t hash_megabytes);
+
+//single threaded fixed depth search of every bench position from an empty hash
+//table, so the node count only changes when the search or generator does.
+//with counters set, hardware counters per node are printed for every position
+U64 search_benchmark(int depth, bool counters = false);
+
+//perft of every bench position, same output as search_benchmark
+U64 perft_benchmark(int depth, bool counters = false);
+
+//filters a stream of positions from random games through a Position_Filter with
+//threads, printing throughput and the false positive rate measured against an
+//exact count of the distinct positions
+void dedup_benchmark(U64 positions, size_t megabytes, int threads);
+
+//df-pn on a suite of mates by checks, each limited to its expected length,
+//printing nodes, time to proof and nps per position and in total
+void mate_benchmark(U64 max_nodes, size_t megabytes);
+
+//builds KPvKP and the tables it converts into in directory, unless they are
+//there already, and checks positions that turn on an en passant capture
+void tablebase_benchmark(const std::string & directory, int threads);
+
+//writes and reads back every legal move of a set of positions in uci and san,
+//printing the round trip errors and moves per second for each function
+void notation_benchmark(int rounds);
+
+//random probes into a transposition table of megabytes and a fixed depth search
+//of every bench position with that hash size, first on normal pages and then
+//with large pages, printing ns per probe, nps and dTLB misses where counted
+void large_pages_benchmark(size_t megabytes, U64 probes, int depth);
+
+//the Polyglot keys of the positions in the format description, reached by
+//playing their moves from the start, checked against the published keys, and
+//key computations per second over rounds passes
+void polyglot_benchmark(int rounds);
+
+//a game viewer stepping back and forth through random games and asking for the
+//legal moves after each step, without and then with a Move_Cache of megabytes,
+//printing queries per second and the cache's hit rate
+void move_cache_benchmark(size_t megabytes, U64 queries);
+
+#endif
@@ -61,6 +61,8 @@
 
 #define U64 uint64_t
 
+class NNUE_Accumulator;
+
 struct game_state{
     uint8_t castling_rights;
     int captured; //first bit is the side, rest is piece type
@@ -84,6 +86,19 @@ struct zobrist_struct {
     U64 ep_squares[40];
 };
 
+//filled by count_moves, promotions count once per piece they can become
+struct move_counts{
+    int by_piece[8]; //indexed by piece type
+    int by_flag[16];
+};
+
+//per node data for gives_check, filled by compute_check_info
+struct check_info{
+    U64 check_squares[8]; //by piece type, squares a piece of the side to move checks from
+    U64 discovered_candidates; //side to move's pieces that alone block its sliders from the enemy king
+    int enemy_king;
+};
+
 class Bitboard_Gen{
     
 public:
@@ -99,6 +114,8 @@ public:
     int current_side = WHITE;
     int ply = 0;
     zobrist_struct zobrist_keys;
+    //optional network accumulator fed by the piece change functions, not owned
+    NNUE_Accumulator* nnue = nullptr;
     
     //initialization
     Bitboard_Gen();
@@ -113,6 +130,19 @@ public:
     int generate_moves(uint16_t * move_list);
     int generate_captures(uint16_t * move_list);
     void generate_attacked_squares();
+    //number of moves generate_moves would write, from popcounts of the destination sets
+    int count_moves(move_counts * counts = nullptr);
+    //exact number of legal moves, popcounted unless in check, pinned or en passant is possible
+    int count_legal_moves();
+    //pieces of the side to move pinned to its own king
+    U64 pinned_pieces();
+    //pieces of candidates that alone block sniper_side's sliders from king_source
+    U64 line_blockers(int king_source, int sniper_side, U64 candidates);
+    //slider attacks from a square through occupied_board
+    U64 diagonal_attacks(int square);
+    U64 orthogonal_attacks(int square);
+    //retractions for the side that just moved, quiet moves only, for retrograde analysis
+    int generate_unmoves(uint16_t * move_list);
     U64 hyp_quint(int source, U64 mask);
     U64 hyp_quint_horiz(int source, U64 mask);
     inline void add_black_pawn_moves();
@@ -146,7 +176,22 @@ public:
     bool is_move_legal();
     //The usual one, side to move needs to escape check
     bool position_in_check();
+    bool square_attacked(int square, int by_side);
+    //checks a move from anywhere (hash table, killers) against this position
+    bool is_pseudo_legal(uint16_t move);
+    void compute_check_info(check_info & info);
+    bool gives_check(uint16_t move, const check_info & info);
     
+    //symmetry, both drop the game history and start again at ply 0
+    //colors swapped and ranks turned over, the same position for the other side
+    void flip_colors();
+    //files mirrored a to h, castling rights are lost
+    void mirror_board();
+    //smallest hash over the color flip and, without castling rights, the mirrors
+    U64 canonical_key();
+    U64 transformed_hash(bool flip, bool mirror_files);
+    void rebuild_from_bitboards(int side, uint8_t castling_rights, int ep_target);
+
     //debugging
     bool check_consistency();
     void print_board();
@@ -165,6 +210,14 @@ public:
     constexpr int get_square_index(U64 bitboard){
         return index_debruges64[(((bitboard) ^ ((bitboard) - 1)) * debruges) >> 58];
     };
+    //number of set bits
+    inline int popcount(U64 bitboard){
+#if defined(_MSC_VER)
+        return (int) __popcnt64(bitboard);
+#else
+        return __builtin_popcountll(bitboard);
+#endif
+    };
     U64 mirror(U64 x);
 
     
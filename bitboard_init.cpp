@@ -5,6 +5,8 @@
 //  Created by Harry Chiu on 11/15/24.
 //
 #include "bitboard_gen.h"
+#include "nnue.h"
+#include <sstream>
 
 Bitboard_Gen::Bitboard_Gen(){
     clear_board();
@@ -22,11 +24,18 @@ void Bitboard_Gen::set_board(std::string fen){
     
     //wipe the board and fill it with 0s
     clear_board();
+    //the accumulator rebuilds itself from the board on the next evaluation
+    if(nnue)
+        nnue->reset();
     zobrist_hash = 0;
     ply = 0;
     uint8_t castling_rights = 0;
     
-    for(char& c : fen){
+    std::istringstream fields(fen);
+    std::string placement, side = "w", castling = "-", ep_square = "-";
+    fields >> placement >> side >> castling >> ep_square;
+    
+    for(char& c : placement){
         if(c == '/'){
             rank--;
             file = 0;
@@ -37,24 +46,33 @@ void Bitboard_Gen::set_board(std::string fen){
             int piece_color = isupper(c) ? WHITE : BLACK;
             add_piece(piece_color, piece_type, rank * 8 + file);
             file++;
-        }else if(rank == 0 && file == 8){
-            if(c == 'K'){
-                castling_rights |= WKS_CASTLING_RIGHTS;
-            }else if(c == 'Q'){
-                castling_rights |= WQS_CASTLING_RIGHTS;
-            }else if(c == 'k'){
-                castling_rights |= BKS_CASTLING_RIGHTS;
-            }else if(c == 'q'){
-                castling_rights |= BQS_CASTLING_RIGHTS;
-            }else if(c == 'w'){
-                current_side = WHITE;
-            }else if(c == 'b'){
-                current_side = BLACK;
-            }
         }
     }
+    current_side = side == "b" ? BLACK : WHITE;
+    for(char& c : castling){
+        if(c == 'K'){
+            castling_rights |= WKS_CASTLING_RIGHTS;
+        }else if(c == 'Q'){
+            castling_rights |= WQS_CASTLING_RIGHTS;
+        }else if(c == 'k'){
+            castling_rights |= BKS_CASTLING_RIGHTS;
+        }else if(c == 'q'){
+            castling_rights |= BQS_CASTLING_RIGHTS;
+        }
+    }
+    //the fen gives the square behind the pawn, the generator wants the pawn itself
+    int ep_target = 0;
+    if(ep_square.size() == 2 && ep_square[0] >= 'a' && ep_square[0] <= 'h'
+       && (ep_square[1] == '3' || ep_square[1] == '6')){
+        int square = (ep_square[1] - '1') * 8 + (ep_square[0] - 'a');
+        ep_target = current_side == WHITE ? square - 8 : square + 8;
+    }
 
-    game_history[ply] = game_state(castling_rights, 0, 0);
+    //same terms make_move keeps in the hash, so set_board and make_move agree
+    zobrist_hash ^= zobrist_keys.castling[castling_rights] ^ zobrist_keys.ep_squares[ep_target];
+    if(current_side == BLACK)
+        zobrist_hash ^= zobrist_keys.color;
+    game_history[ply] = game_state(castling_rights, 0, ep_target);
     hash_history[ply] = zobrist_hash;
 }
 
@@ -5,6 +5,7 @@
 //  Created by Harry Chiu on 10/17/24.
 //
 #include "bitboard_gen.h"
+#include "instrument.h"
 
 #if defined(__APPLE__)
     #include <libkern/OSByteOrder.h>
@@ -21,25 +22,35 @@
 
 //generates all pseudolegal moves
 int Bitboard_Gen::generate_moves(uint16_t * m_list){
+    INSTR_SAMPLE_BEGIN();
     move_list = m_list;
     occupied_board = bitboards[WHITE] | bitboards[BLACK];
     empty_board = ~occupied_board;
     generate_attacked_squares();
+    INSTR_SAMPLE_STAGE(INSTR_STAGE_ATTACKS);
     
     if(current_side){
         add_black_pawn_moves();
+        INSTR_SAMPLE_STAGE(INSTR_STAGE_PAWNS);
         add_black_castle_moves();
     }
     else{
         add_white_pawn_moves();
+        INSTR_SAMPLE_STAGE(INSTR_STAGE_PAWNS);
         add_white_castle_moves();
     }
+    INSTR_SAMPLE_STAGE(INSTR_STAGE_CASTLES);
     
     add_knight_moves();
+    INSTR_SAMPLE_STAGE(INSTR_STAGE_KNIGHTS);
     add_king_moves();
+    INSTR_SAMPLE_STAGE(INSTR_STAGE_KING);
     add_diag_moves();
+    INSTR_SAMPLE_STAGE(INSTR_STAGE_DIAGONAL);
     add_orthog_moves();
+    INSTR_SAMPLE_STAGE(INSTR_STAGE_ORTHOGONAL);
     
+    INSTR_MOVES(m_list, (int) (move_list - m_list), mailbox);
     return (int) (move_list - m_list);
 }
 
@@ -214,6 +225,152 @@ inline void Bitboard_Gen::add_orthog_moves(){
 
 
 
+//counts what generate_moves would write without writing it, each destination
+//set is popcounted and promotions are counted once per promotion piece
+int Bitboard_Gen::count_moves(move_counts * counts){
+    occupied_board = bitboards[WHITE] | bitboards[BLACK];
+    empty_board = ~occupied_board;
+    generate_attacked_squares();
+    if(counts){
+        for(int i = 0; i < 8; i++)
+            counts->by_piece[i] = 0;
+        for(int i = 0; i < 16; i++)
+            counts->by_flag[i] = 0;
+    }
+    int total = 0;
+    auto tally = [&](int piece, int flag, int number){
+        total += number;
+        if(counts){
+            counts->by_piece[piece] += number;
+            counts->by_flag[flag] += number;
+        }
+    };
+    U64 enemy = bitboards[!current_side];
+    
+    //pawns, shifted the same way as add_white_pawn_moves/add_black_pawn_moves
+    U64 side_pawn_board = bitboards[current_side] & bitboards[PAWN_BOARD];
+    U64 pushes, double_pushes, left_captures, right_captures, last_rank;
+    if(current_side){
+        pushes = (side_pawn_board >> 8) & empty_board;
+        double_pushes = ((pushes & rank_masks[5]) >> 8) & empty_board;
+        left_captures = (side_pawn_board >> 9) & enemy & (~file_masks[7]);
+        right_captures = (side_pawn_board >> 7) & enemy & (~file_masks[0]);
+        last_rank = rank_masks[0];
+    }else{
+        pushes = (side_pawn_board << 8) & empty_board;
+        double_pushes = ((pushes & rank_masks[2]) << 8) & empty_board;
+        left_captures = (side_pawn_board << 9) & enemy & (~file_masks[0]);
+        right_captures = (side_pawn_board << 7) & enemy & (~file_masks[7]);
+        last_rank = rank_masks[7];
+    }
+    tally(PAWN_BOARD, QUIET_FLAG, popcount(pushes & ~last_rank));
+    tally(PAWN_BOARD, DOUBLE_PAWN_PUSH_FLAG, popcount(double_pushes));
+    tally(PAWN_BOARD, CAPTURE_FLAG, popcount(left_captures & ~last_rank) + popcount(right_captures & ~last_rank));
+    int promotions = popcount(pushes & last_rank);
+    int promo_captures = popcount(left_captures & last_rank) + popcount(right_captures & last_rank);
+    for(int flag = BISHOP_PROMO_FLAG; flag <= QUEEN_PROMO_FLAG; flag++){
+        tally(PAWN_BOARD, flag, promotions);
+        tally(PAWN_BOARD, flag + 4, promo_captures);
+    }
+    tally(PAWN_BOARD, EN_PASSANT_FLAG, popcount(ep_target_lookup[game_history[ply].ep_target] & side_pawn_board));
+    
+    //castling, same conditions as the add_*_castle_moves functions
+    uint8_t rights = game_history[ply].castling_rights;
+    int base = current_side ? 56 : 0;
+    if((rights & (current_side ? BKS_CASTLING_RIGHTS : WKS_CASTLING_RIGHTS))
+       && !(enemy_attacked_board & (occupy_square[base + 4] | occupy_square[base + 5] | occupy_square[base + 6]))
+       && !(occupied_board & (occupy_square[base + 5] | occupy_square[base + 6])))
+        tally(KING_BOARD, KINGSIDE_CASTLE_FLAG, 1);
+    if((rights & (current_side ? BQS_CASTLING_RIGHTS : WQS_CASTLING_RIGHTS))
+       && !(enemy_attacked_board & (occupy_square[base + 2] | occupy_square[base + 3] | occupy_square[base + 4]))
+       && !(occupied_board & (occupy_square[base + 1] | occupy_square[base + 2] | occupy_square[base + 3])))
+        tally(KING_BOARD, QUEENSIDE_CASTLE_FLAG, 1);
+    
+    U64 board = bitboards[current_side] & bitboards[KNIGHT_BOARD];
+    while(board){
+        int source = pop_lsb(&board);
+        tally(KNIGHT_BOARD, QUIET_FLAG, popcount(knight_move_lookup[source] & empty_board));
+        tally(KNIGHT_BOARD, CAPTURE_FLAG, popcount(knight_move_lookup[source] & enemy));
+    }
+    int king_source = get_square_index(bitboards[current_side] & bitboards[KING_BOARD]);
+    tally(KING_BOARD, QUIET_FLAG, popcount(king_move_lookup[king_source] & empty_board & (~enemy_attacked_board)));
+    tally(KING_BOARD, CAPTURE_FLAG, popcount(king_move_lookup[king_source] & enemy & (~enemy_attacked_board)));
+    board = bitboards[current_side] & (bitboards[BISHOP_BOARD] | bitboards[QUEEN_BOARD]);
+    while(board){
+        int source = pop_lsb(&board);
+        U64 res = hyp_quint(source, diagonal_masks[source_to_diagonal[source]]);
+        res |= hyp_quint(source, antidiagonal_masks[source_to_antidiagonal[source]]);
+        tally(mailbox[source] >> 1, QUIET_FLAG, popcount(res & empty_board));
+        tally(mailbox[source] >> 1, CAPTURE_FLAG, popcount(res & enemy));
+    }
+    board = bitboards[current_side] & (bitboards[ROOK_BOARD] | bitboards[QUEEN_BOARD]);
+    while(board){
+        int source = pop_lsb(&board);
+        U64 res = hyp_quint(source, file_masks[source_to_file[source]]);
+        res |= hyp_quint_horiz(source, rank_masks[source_to_rank[source]]);
+        tally(mailbox[source] >> 1, QUIET_FLAG, popcount(res & empty_board));
+        tally(mailbox[source] >> 1, CAPTURE_FLAG, popcount(res & enemy));
+    }
+    return total;
+}
+
+//when the king is not in check and nothing is pinned, every pseudolegal move
+//except en passant is legal (king moves already avoid attacked squares), so the
+//count is exact. Otherwise fall back to making each move
+int Bitboard_Gen::count_legal_moves(){
+    int total = count_moves();
+    U64 side_pawn_board = bitboards[current_side] & bitboards[PAWN_BOARD];
+    if(!(enemy_attacked_board & bitboards[current_side] & bitboards[KING_BOARD])
+       && !(ep_target_lookup[game_history[ply].ep_target] & side_pawn_board)
+       && !pinned_pieces())
+        return total;
+    
+    uint16_t m_list[256];
+    int num_moves = generate_moves(m_list);
+    total = 0;
+    for(int i = 0; i < num_moves; i++){
+        make_move(m_list[i]);
+        total += !is_move_legal();
+        unmake_move(m_list[i]);
+    }
+    return total;
+}
+
+U64 Bitboard_Gen::pinned_pieces(){
+    int king_source = get_square_index(bitboards[current_side] & bitboards[KING_BOARD]);
+    return line_blockers(king_source, !current_side, bitboards[current_side]);
+}
+
+//for each line through the king, lift the candidate pieces the king sees and
+//look again, a slider of sniper_side that appears is blocked only by them
+U64 Bitboard_Gen::line_blockers(int king_source, int sniper_side, U64 candidates){
+    U64 diagonal_snipers = bitboards[sniper_side] & (bitboards[BISHOP_BOARD] | bitboards[QUEEN_BOARD]);
+    U64 orthogonal_snipers = bitboards[sniper_side] & (bitboards[ROOK_BOARD] | bitboards[QUEEN_BOARD]);
+    U64 saved_occupied = occupied_board;
+    occupied_board = bitboards[WHITE] | bitboards[BLACK];
+    U64 lines[4] = {diagonal_masks[source_to_diagonal[king_source]], antidiagonal_masks[source_to_antidiagonal[king_source]],
+        file_masks[source_to_file[king_source]], rank_masks[source_to_rank[king_source]]};
+    U64 found = 0;
+    for(int i = 0; i < 4; i++){
+        U64 snipers = (i < 2 ? diagonal_snipers : orthogonal_snipers) & lines[i];
+        if(!snipers)
+            continue;
+        U64 seen = i == 3 ? hyp_quint_horiz(king_source, lines[i]) : hyp_quint(king_source, lines[i]);
+        U64 blockers = seen & candidates;
+        if(!blockers)
+            continue;
+        occupied_board ^= blockers;
+        U64 xray = (i == 3 ? hyp_quint_horiz(king_source, lines[i]) : hyp_quint(king_source, lines[i])) & snipers & ~seen;
+        occupied_board ^= blockers;
+        while(xray){
+            int sniper = pop_lsb(&xray);
+            found |= (i == 3 ? hyp_quint_horiz(sniper, lines[i]) : hyp_quint(sniper, lines[i])) & blockers;
+        }
+    }
+    occupied_board = saved_occupied;
+    return found;
+}
+
 //generates only capture moves, for the quiesence search
 int Bitboard_Gen::generate_captures(uint16_t * m_list){
     move_list = m_list;
@@ -312,8 +469,57 @@ int Bitboard_Gen::generate_captures(uint16_t * m_list){
     return (int) (move_list - m_list);
 }
 
+//generates every non capturing, non promoting move the side that is not to move
+//could have just played, encoded as (current square, previous square, QUIET_FLAG)
+//uncaptures and unpromotions change the material and are left to the caller
+int Bitboard_Gen::generate_unmoves(uint16_t * m_list){
+    move_list = m_list;
+    occupied_board = bitboards[WHITE] | bitboards[BLACK];
+    empty_board = ~occupied_board;
+    int mover = !current_side;
+    
+    //pawns step back, and back two squares from the 4th/5th rank
+    U64 mover_pawns = bitboards[mover] & bitboards[PAWN_BOARD];
+    while(mover_pawns){
+        int source = pop_lsb(&mover_pawns);
+        int step = mover == WHITE ? -8 : 8;
+        int previous = source + step;
+        //a pawn can't have come from its own back rank
+        if(source_to_rank[previous] == (mover == WHITE ? 0 : 7) || !(empty_board & occupy_square[previous]))
+            continue;
+        *move_list++ = (source << 10) | (previous << 4) | QUIET_FLAG;
+        if(source_to_rank[source] == (mover == WHITE ? 3 : 4) && (empty_board & occupy_square[previous + step]))
+            *move_list++ = (source << 10) | ((previous + step) << 4) | QUIET_FLAG;
+    }
+    
+    //every other piece moves symmetrically, so it came from a square it attacks now
+    U64 board = bitboards[mover] & bitboards[KNIGHT_BOARD];
+    while(board){
+        int source = pop_lsb(&board);
+        add_quiet_moves(source, knight_move_lookup[source] & empty_board);
+    }
+    int king_source = get_square_index(bitboards[mover] & bitboards[KING_BOARD]);
+    add_quiet_moves(king_source, king_move_lookup[king_source] & empty_board);
+    board = bitboards[mover] & (bitboards[BISHOP_BOARD] | bitboards[QUEEN_BOARD]);
+    while(board){
+        int source = pop_lsb(&board);
+        U64 res = hyp_quint(source, diagonal_masks[source_to_diagonal[source]]);
+        res |= hyp_quint(source, antidiagonal_masks[source_to_antidiagonal[source]]);
+        add_quiet_moves(source, res & empty_board);
+    }
+    board = bitboards[mover] & (bitboards[ROOK_BOARD] | bitboards[QUEEN_BOARD]);
+    while(board){
+        int source = pop_lsb(&board);
+        U64 res = hyp_quint(source, file_masks[source_to_file[source]]);
+        res |= hyp_quint_horiz(source, rank_masks[source_to_rank[source]]);
+        add_quiet_moves(source, res & empty_board);
+    }
+    return (int) (move_list - m_list);
+}
+
 //generates all squares attacked by side
 void Bitboard_Gen::generate_attacked_squares(){
+    INSTR_COUNT(attacked_square_calls);
     enemy_attacked_board = 0;
     //bulk process all pawn attacks
     U64 side_pawn_board = bitboards[!current_side] & bitboards[PAWN_BOARD];
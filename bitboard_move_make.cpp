@@ -6,8 +6,13 @@
 //
 
 #include "bitboard_gen.h"
+#include "nnue.h"
+#include "instrument.h"
 
 void Bitboard_Gen::make_move(uint16_t move){
+    INSTR_COUNT_INDEX(make_by_flag, move & 0x0f);
+    if(nnue)
+        nnue->push();
     pre_update_hash();
     int ep_target = 0;
     int captured_piece = 0;
@@ -60,6 +65,9 @@ void Bitboard_Gen::make_move(uint16_t move){
 }
 
 void Bitboard_Gen::unmake_move(uint16_t move){
+    INSTR_COUNT_INDEX(unmake_by_flag, move & 0x0f);
+    if(nnue)
+        nnue->pop();
     pre_update_hash();
     
     int source = (move >> 10) & 0x3f;
@@ -96,13 +104,18 @@ void Bitboard_Gen::unmake_move(uint16_t move){
 }
 
 void Bitboard_Gen::make_null_move(){
+    if(nnue)
+        nnue->push();
     pre_update_hash();
     ply++;
     game_history[ply] = game_state(game_history[ply - 1].castling_rights, 0, 0);
     post_update_hash();
+    hash_history[ply] = zobrist_hash;
 }
 
 void Bitboard_Gen::unmake_null_move(){
+    if(nnue)
+        nnue->pop();
     pre_update_hash();
     ply--;
     post_update_hash();
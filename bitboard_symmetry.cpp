@@ -0,0 +1,83 @@
+//
+//  bitboard_symmetry.cpp
+//  InvincibleSummer
+//
+//  Color flip and file mirror of a position, and a key shared by every
+//  position in the same symmetry class.
+//
+
+#include "bitboard_gen.h"
+#include "nnue.h"
+#include <algorithm>
+
+//white kingside and queenside rights trade places with black's
+static inline uint8_t flip_castling_rights(uint8_t rights){
+    return ((rights & (WKS_CASTLING_RIGHTS | WQS_CASTLING_RIGHTS)) >> 2)
+        | ((rights & (BKS_CASTLING_RIGHTS | BQS_CASTLING_RIGHTS)) << 2);
+}
+
+//hash of the position after an optional color flip and file mirror, without changing the board
+U64 Bitboard_Gen::transformed_hash(bool flip, bool mirror_files){
+    int square_xor = (flip ? 56 : 0) ^ (mirror_files ? 7 : 0);
+    U64 hash = 0;
+    U64 occupied = bitboards[WHITE] | bitboards[BLACK];
+    while(occupied){
+        int square = pop_lsb(&occupied);
+        hash ^= zobrist_keys.piecesquare[mailbox[square] ^ flip][square ^ square_xor];
+    }
+    const game_state & state = game_history[ply];
+    int ep_target = state.ep_target ? state.ep_target ^ square_xor : 0;
+    hash ^= zobrist_keys.castling[flip ? flip_castling_rights(state.castling_rights) : state.castling_rights];
+    hash ^= zobrist_keys.ep_squares[ep_target];
+    if((current_side ^ flip) == BLACK)
+        hash ^= zobrist_keys.color;
+    return hash;
+}
+
+//mailbox, hash and history from the bitboards and the new state, earlier plies are dropped
+void Bitboard_Gen::rebuild_from_bitboards(int side, uint8_t castling_rights, int ep_target){
+    for(int i = 0; i < 64; i++)
+        mailbox[i] = 0;
+    for(int type = PAWN_BOARD; type <= KING_BOARD; type++){
+        for(int color = WHITE; color <= BLACK; color++){
+            U64 pieces = bitboards[type] & bitboards[color];
+            while(pieces)
+                mailbox[pop_lsb(&pieces)] = color + (type << 1);
+        }
+    }
+    current_side = side;
+    ply = 0;
+    game_history[0] = game_state(castling_rights, 0, ep_target);
+    zobrist_hash = transformed_hash(false, false);
+    hash_history[0] = zobrist_hash;
+    if(nnue)
+        nnue->reset();
+}
+
+void Bitboard_Gen::flip_colors(){
+    const game_state & state = game_history[ply];
+    uint8_t castling_rights = flip_castling_rights(state.castling_rights);
+    int ep_target = state.ep_target ? state.ep_target ^ 56 : 0;
+    //byte swapping a bitboard swaps the ranks
+    for(int i = 0; i < 8; i++)
+        bitboards[i] = bswap_64(bitboards[i]);
+    std::swap(bitboards[WHITE], bitboards[BLACK]);
+    rebuild_from_bitboards(current_side ^ 1, castling_rights, ep_target);
+}
+
+void Bitboard_Gen::mirror_board(){
+    const game_state & state = game_history[ply];
+    int ep_target = state.ep_target ? state.ep_target ^ 7 : 0;
+    for(int i = 0; i < 8; i++)
+        bitboards[i] = mirror(bitboards[i]);
+    //the kings and rooks are no longer where castling needs them
+    rebuild_from_bitboards(current_side, 0, ep_target);
+}
+
+U64 Bitboard_Gen::canonical_key(){
+    U64 key = std::min(zobrist_hash, transformed_hash(true, false));
+    //a mirror is only the same position when neither side can castle
+    if(!game_history[ply].castling_rights)
+        key = std::min(key, std::min(transformed_hash(false, true), transformed_hash(true, true)));
+    return key;
+}
@@ -6,8 +6,13 @@
 //
 
 #include "bitboard_gen.h"
+#include "nnue.h"
+#include "instrument.h"
+#include "geometry.h"
 
 void Bitboard_Gen::move_piece(int source, int dest){
+    if(nnue)
+        nnue->record(mailbox[source], source, dest);
     zobrist_hash ^= zobrist_keys.piecesquare[mailbox[source]][source] ^ zobrist_keys.piecesquare[mailbox[source]][dest];
     U64 mask = occupy_square[source] | occupy_square[dest];
     bitboards[mailbox[source] & 1] ^= mask;
@@ -17,6 +22,8 @@ void Bitboard_Gen::move_piece(int source, int dest){
 }
 
 void Bitboard_Gen::add_piece(int piece_color, int piece_type, int square_index){
+    if(nnue)
+        nnue->record(piece_color + (piece_type << 1), -1, square_index);
     bitboards[piece_type] |= occupy_square[square_index];
     bitboards[piece_color] |= occupy_square[square_index];
     mailbox[square_index] = piece_color + (piece_type << 1);
@@ -24,6 +31,8 @@ void Bitboard_Gen::add_piece(int piece_color, int piece_type, int square_index){
 }
 
 void Bitboard_Gen::add_piece(int piece, int square_index){
+    if(nnue)
+        nnue->record(piece, -1, square_index);
     bitboards[piece & 1] |= occupy_square[square_index];
     bitboards[piece >> 1] |= occupy_square[square_index];
     mailbox[square_index] = piece;
@@ -31,6 +40,8 @@ void Bitboard_Gen::add_piece(int piece, int square_index){
 }
 
 void Bitboard_Gen::remove_piece(int source){
+    if(nnue)
+        nnue->record(mailbox[source], source, -1);
     zobrist_hash ^= zobrist_keys.piecesquare[mailbox[source]][source];
     bitboards[mailbox[source] & 1] &= ~occupy_square[source];
     bitboards[mailbox[source] >> 1] &= ~occupy_square[source];
@@ -52,6 +63,10 @@ U64 Bitboard_Gen::perft(int depth){
     if (depth == 0){
         return 1ULL;
     }
+    //the last ply only needs to know how many moves there are
+    if (depth == 1){
+        return count_legal_moves();
+    }
     U64 nodes = 0;
     uint16_t move_list[256];
     int num_moves;
@@ -69,6 +84,7 @@ U64 Bitboard_Gen::perft(int depth){
 
 
 bool Bitboard_Gen::is_move_legal(){
+    INSTR_COUNT(legality_checks);
     int king_source = get_square_index(bitboards[!current_side] & bitboards[KING_BOARD]);
     occupied_board = bitboards[WHITE] | bitboards[BLACK];
     //potential squares the king can be attacked by pawns
@@ -95,6 +111,7 @@ bool Bitboard_Gen::is_move_legal(){
     if(board & bitboards[current_side] & (bitboards[ROOK_BOARD] | bitboards[QUEEN_BOARD])){
         return true;
     }
+    INSTR_COUNT(legal_moves);
     return false;
 }
 
@@ -128,6 +145,170 @@ bool Bitboard_Gen::position_in_check(){
     return false;
 }
 
+//same tests as position_in_check for any square, with the current occupancy
+bool Bitboard_Gen::square_attacked(int square, int by_side){
+    occupied_board = bitboards[WHITE] | bitboards[BLACK];
+    if(pawn_capture_lookup[!by_side][square] & bitboards[by_side] & bitboards[PAWN_BOARD])
+        return true;
+    if(knight_move_lookup[square] & bitboards[by_side] & bitboards[KNIGHT_BOARD])
+        return true;
+    if(king_move_lookup[square] & bitboards[by_side] & bitboards[KING_BOARD])
+        return true;
+    U64 board = hyp_quint(square, diagonal_masks[source_to_diagonal[square]]);
+    board |= hyp_quint(square, antidiagonal_masks[source_to_antidiagonal[square]]);
+    if(board & bitboards[by_side] & (bitboards[BISHOP_BOARD] | bitboards[QUEEN_BOARD]))
+        return true;
+    board = hyp_quint(square, file_masks[source_to_file[square]]);
+    board |= hyp_quint_horiz(square, rank_masks[source_to_rank[square]]);
+    return board & bitboards[by_side] & (bitboards[ROOK_BOARD] | bitboards[QUEEN_BOARD]);
+}
+
+//true exactly when generate_moves would produce the move in this position, so
+//hash and killer moves from other positions can be played without generating
+bool Bitboard_Gen::is_pseudo_legal(uint16_t move){
+    int source = (move >> 10) & 0x3f;
+    int dest = (move >> 4) & 0x3f;
+    int flag = move & 0x0f;
+    U64 source_bit = occupy_square[source];
+    U64 dest_bit = occupy_square[dest];
+    if(!(bitboards[current_side] & source_bit) || flag == 6 || flag == 7)
+        return false;
+    int piece_type = mailbox[source] >> 1;
+    U64 enemy = bitboards[!current_side];
+    occupied_board = bitboards[WHITE] | bitboards[BLACK];
+    //captures need an enemy piece on the destination, everything else an empty square
+    bool capture = (flag & CAPTURE_FLAG) && flag != EN_PASSANT_FLAG;
+    if(capture ? !(enemy & dest_bit) : (occupied_board & dest_bit))
+        return false;
+    
+    if(piece_type == PAWN_BOARD){
+        int forward = current_side ? -8 : 8;
+        U64 last_rank = rank_masks[current_side ? 0 : 7];
+        bool promotion = flag & 8;
+        if(flag == EN_PASSANT_FLAG){
+            int ep_target = game_history[ply].ep_target;
+            return (ep_target_lookup[ep_target] & source_bit) && dest == ep_target + forward;
+        }
+        if(promotion != (bool) (last_rank & dest_bit))
+            return false;
+        if(flag == DOUBLE_PAWN_PUSH_FLAG)
+            return source_to_rank[source] == (current_side ? 6 : 1) && dest == source + 2 * forward
+                && !(occupied_board & occupy_square[source + forward]);
+        if(capture)
+            return pawn_capture_lookup[current_side][source] & dest_bit;
+        return (flag == QUIET_FLAG || promotion) && dest == source + forward;
+    }
+    //only pawns push twice, take en passant or promote
+    if(flag != QUIET_FLAG && flag != CAPTURE_FLAG && flag != KINGSIDE_CASTLE_FLAG && flag != QUEENSIDE_CASTLE_FLAG)
+        return false;
+    
+    if(piece_type == KING_BOARD){
+        if(flag == KINGSIDE_CASTLE_FLAG || flag == QUEENSIDE_CASTLE_FLAG){
+            int base = current_side ? 56 : 0;
+            bool kingside = flag == KINGSIDE_CASTLE_FLAG;
+            uint8_t right = current_side ? (kingside ? BKS_CASTLING_RIGHTS : BQS_CASTLING_RIGHTS)
+                                         : (kingside ? WKS_CASTLING_RIGHTS : WQS_CASTLING_RIGHTS);
+            if(source != base + 4 || dest != base + (kingside ? 6 : 2) || !(game_history[ply].castling_rights & right))
+                return false;
+            if(occupied_board & (kingside ? occupy_square[base + 5] : (occupy_square[base + 1] | occupy_square[base + 3])))
+                return false;
+            int step = kingside ? 1 : -1;
+            return !square_attacked(base + 4, !current_side) && !square_attacked(base + 4 + step, !current_side)
+                && !square_attacked(base + 4 + 2 * step, !current_side);
+        }
+        return (king_move_lookup[source] & dest_bit) && !square_attacked(dest, !current_side);
+    }
+    if(flag == KINGSIDE_CASTLE_FLAG || flag == QUEENSIDE_CASTLE_FLAG)
+        return false;
+    
+    if(piece_type == KNIGHT_BOARD)
+        return knight_move_lookup[source] & dest_bit;
+    U64 reach = 0;
+    if(piece_type == BISHOP_BOARD || piece_type == QUEEN_BOARD){
+        reach |= hyp_quint(source, diagonal_masks[source_to_diagonal[source]]);
+        reach |= hyp_quint(source, antidiagonal_masks[source_to_antidiagonal[source]]);
+    }
+    if(piece_type == ROOK_BOARD || piece_type == QUEEN_BOARD){
+        reach |= hyp_quint(source, file_masks[source_to_file[source]]);
+        reach |= hyp_quint_horiz(source, rank_masks[source_to_rank[source]]);
+    }
+    return reach & dest_bit;
+}
+
+U64 Bitboard_Gen::diagonal_attacks(int square){
+    return hyp_quint(square, diagonal_masks[source_to_diagonal[square]])
+         | hyp_quint(square, antidiagonal_masks[source_to_antidiagonal[square]]);
+}
+
+U64 Bitboard_Gen::orthogonal_attacks(int square){
+    return hyp_quint(square, file_masks[source_to_file[square]])
+         | hyp_quint_horiz(square, rank_masks[source_to_rank[square]]);
+}
+
+//squares each piece type would check the enemy king from, and the pieces whose
+//move can uncover a check from one of our sliders
+void Bitboard_Gen::compute_check_info(check_info & info){
+    int king_source = get_square_index(bitboards[!current_side] & bitboards[KING_BOARD]);
+    occupied_board = bitboards[WHITE] | bitboards[BLACK];
+    info.enemy_king = king_source;
+    info.check_squares[WHITE] = info.check_squares[BLACK] = 0;
+    info.check_squares[PAWN_BOARD] = pawn_capture_lookup[!current_side][king_source];
+    info.check_squares[KNIGHT_BOARD] = knight_move_lookup[king_source];
+    info.check_squares[BISHOP_BOARD] = diagonal_attacks(king_source);
+    info.check_squares[ROOK_BOARD] = orthogonal_attacks(king_source);
+    info.check_squares[QUEEN_BOARD] = info.check_squares[BISHOP_BOARD] | info.check_squares[ROOK_BOARD];
+    info.check_squares[KING_BOARD] = 0;
+    info.discovered_candidates = line_blockers(king_source, current_side, bitboards[current_side]);
+}
+
+//whether a pseudolegal move checks the enemy king, without making it
+bool Bitboard_Gen::gives_check(uint16_t move, const check_info & info){
+    int source = (move >> 10) & 0x3f;
+    int dest = (move >> 4) & 0x3f;
+    int flag = move & 0x0f;
+    int king_source = info.enemy_king;
+    U64 king_bit = occupy_square[king_source];
+    bool castle = flag == KINGSIDE_CASTLE_FLAG || flag == QUEENSIDE_CASTLE_FLAG;
+    
+    //direct checks
+    if(!(flag & 8) && !castle && (info.check_squares[mailbox[source] >> 1] & occupy_square[dest]))
+        return true;
+    //discovered checks, unless the piece stays on the line it was blocking
+    if((info.discovered_candidates & occupy_square[source]) && !(line[king_source][source] & occupy_square[dest]))
+        return true;
+    if(flag == QUIET_FLAG || flag == DOUBLE_PAWN_PUSH_FLAG || flag == CAPTURE_FLAG)
+        return false;
+    
+    U64 saved_occupied = occupied_board;
+    occupied_board = (bitboards[WHITE] | bitboards[BLACK]) ^ occupy_square[source];
+    bool check = false;
+    if(flag & 8){
+        //the promoted piece attacks through the square the pawn left
+        occupied_board |= occupy_square[dest];
+        int promo_type = (flag & 3) + BISHOP_BOARD;
+        U64 attacks = promo_type == KNIGHT_BOARD ? knight_move_lookup[dest] : 0;
+        if(promo_type == BISHOP_BOARD || promo_type == QUEEN_BOARD)
+            attacks |= diagonal_attacks(dest);
+        if(promo_type == ROOK_BOARD || promo_type == QUEEN_BOARD)
+            attacks |= orthogonal_attacks(dest);
+        check = attacks & king_bit;
+    }else if(flag == EN_PASSANT_FLAG){
+        //removing the captured pawn can open a line as well
+        occupied_board ^= occupy_square[dest] | occupy_square[game_history[ply].ep_target];
+        check = (diagonal_attacks(king_source) & bitboards[current_side] & (bitboards[BISHOP_BOARD] | bitboards[QUEEN_BOARD]))
+             || (orthogonal_attacks(king_source) & bitboards[current_side] & (bitboards[ROOK_BOARD] | bitboards[QUEEN_BOARD]));
+    }else if(castle){
+        //only the rook can check, from the square next to the king
+        int base = current_side ? 56 : 0;
+        int rook_source = base + (flag == KINGSIDE_CASTLE_FLAG ? 7 : 0);
+        int rook_dest = base + (flag == KINGSIDE_CASTLE_FLAG ? 5 : 3);
+        occupied_board ^= occupy_square[dest] | occupy_square[rook_source] | occupy_square[rook_dest];
+        check = orthogonal_attacks(rook_dest) & king_bit;
+    }
+    occupied_board = saved_occupied;
+    return check;
+}
+
 char print_piece_arr[16] = {'0', '1', '2', '3', 'P', 'p', 'B', 'b', 'N', 'n', 'R', 'r', 'Q', 'q', 'K', 'k'};
 
 void Bitboard_Gen::print_board(){
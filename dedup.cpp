@@ -0,0 +1,131 @@
+//
+//  dedup.cpp
+//  InvincibleSummer
+//
+
+#include "dedup.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <new>
+#include <string>
+#include <thread>
+
+#define DEDUP_BATCH_LINES 65536
+#define DEDUP_CHUNK_LINES 1024
+
+static inline U64 mix64(U64 value){
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+U64 secondary_key(const Bitboard_Gen & board){
+    const game_state & state = board.game_history[board.ply];
+    U64 key = mix64((U64) board.current_side | (U64) state.castling_rights << 1 | (U64) state.ep_target << 5);
+    for(int i = 0; i < 8; i++)
+        key = mix64(key ^ board.bitboards[i]);
+    return key;
+}
+
+Position_Filter::Position_Filter(size_t megabytes, int shard_count){
+    num_shards = std::max(1, shard_count);
+    size_t total_blocks = std::max<size_t>(megabytes, 1) * 1024 * 1024 / sizeof(filter_block);
+    blocks_per_shard = std::max<size_t>(total_blocks / num_shards, 1);
+    shards.reset(new shard[num_shards]);
+    if(!storage.allocate(num_shards * blocks_per_shard * sizeof(filter_block)))
+        throw std::bad_alloc();
+    storage.first_touch(std::max<int>(1, (int) std::thread::hardware_concurrency()));
+    for(size_t i = 0; i < num_shards; i++)
+        shards[i].blocks = storage.as<filter_block>() + i * blocks_per_shard;
+}
+
+bool Position_Filter::test_and_insert(U64 zobrist, U64 secondary){
+    filter_block & line = block(zobrist);
+    bool seen = true;
+    for(int i = 0; i < DEDUP_BLOCK_WORDS; i++){
+        U64 bit = 1ULL << ((secondary >> (i * 6)) & 63);
+        //cheap read first, most words of a duplicate already have the bit
+        if(!(line.words[i].load(std::memory_order_relaxed) & bit))
+            seen &= (line.words[i].fetch_or(bit, std::memory_order_relaxed) & bit) != 0;
+    }
+    if(!seen)
+        shards[(zobrist >> 40) % num_shards].inserted.fetch_add(1, std::memory_order_relaxed);
+    return seen;
+}
+
+bool Position_Filter::contains(U64 zobrist, U64 secondary) const{
+    const filter_block & line = block(zobrist);
+    for(int i = 0; i < DEDUP_BLOCK_WORDS; i++){
+        if(!(line.words[i].load(std::memory_order_relaxed) & (1ULL << ((secondary >> (i * 6)) & 63))))
+            return false;
+    }
+    return true;
+}
+
+U64 Position_Filter::inserted() const{
+    U64 total = 0;
+    for(size_t i = 0; i < num_shards; i++)
+        total += shards[i].inserted.load(std::memory_order_relaxed);
+    return total;
+}
+
+double Position_Filter::expected_false_positive_rate() const{
+    //each insertion sets one bit per word of its block
+    double per_block = (double) inserted() / (num_shards * blocks_per_shard);
+    double word_fill = 1 - std::exp(-per_block / 64);
+    return std::pow(word_fill, DEDUP_BLOCK_WORDS);
+}
+
+dedup_stats dedup_fens(std::istream & in, std::ostream & out, Position_Filter & filter, int threads){
+    dedup_stats stats;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> lines;
+    std::vector<U64> zobrist_keys, secondary_keys;
+    std::string line;
+    threads = std::max(1, threads);
+    while(in){
+        lines.clear();
+        while(lines.size() < DEDUP_BATCH_LINES && std::getline(in, line)){
+            if(!line.empty())
+                lines.push_back(line);
+        }
+        if(lines.empty())
+            break;
+        //threads parse the batch, the fens are most of the work
+        zobrist_keys.resize(lines.size());
+        secondary_keys.resize(lines.size());
+        std::atomic<size_t> next{0};
+        auto worker = [&](){
+            Bitboard_Gen board;
+            board.init_zobrist_keys();
+            for(size_t begin = next.fetch_add(DEDUP_CHUNK_LINES); begin < lines.size(); begin = next.fetch_add(DEDUP_CHUNK_LINES)){
+                for(size_t i = begin; i < std::min(begin + DEDUP_CHUNK_LINES, lines.size()); i++){
+                    board.set_board(lines[i]);
+                    zobrist_keys[i] = board.zobrist_hash;
+                    secondary_keys[i] = secondary_key(board);
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for(int i = 1; i < threads; i++)
+            pool.emplace_back(worker);
+        worker();
+        for(auto & thread : pool)
+            thread.join();
+
+        //then the filter in input order, so the first copy is the one kept whatever the thread count
+        for(size_t i = 0; i < lines.size(); i++){
+            if(!filter.test_and_insert(zobrist_keys[i], secondary_keys[i]))
+                out << lines[i] << '\n';
+            else
+                stats.duplicates++;
+        }
+        stats.positions += lines.size();
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
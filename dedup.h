@@ -0,0 +1,74 @@
+//
+//  dedup.h
+//  InvincibleSummer
+//
+//  Position deduplication for training data. Position_Filter is a blocked Bloom
+//  filter with a fixed memory budget: zobrist_hash picks a shard and a cache line
+//  inside it, and an independent secondary key picks one bit in each of the
+//  line's 8 words. Bits are set with atomic ors, so the filter itself is safe to
+//  share between threads without locks. dedup_fens parses fens with threads but
+//  runs each batch through the filter in a single pass in input order. Like any
+//  Bloom filter it never misses a duplicate, but a small share of new positions
+//  are reported as seen.
+//
+#include "bitboard_gen.h"
+#include "large_pages.h"
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#ifndef DEDUP
+#define DEDUP
+
+#define DEDUP_BLOCK_WORDS 8
+#define DEDUP_DEFAULT_SHARDS 64
+
+//hash of the board independent of zobrist_hash, used to check the zobrist match
+U64 secondary_key(const Bitboard_Gen & board);
+
+struct dedup_stats{
+    U64 positions = 0;
+    U64 duplicates = 0;
+    double seconds = 0;
+};
+
+class Position_Filter{
+public:
+    Position_Filter(size_t megabytes, int shards = DEDUP_DEFAULT_SHARDS);
+
+    //true if the position was seen before (or is a false positive), otherwise remembers it
+    bool test_and_insert(U64 zobrist, U64 secondary);
+    bool contains(U64 zobrist, U64 secondary) const;
+
+    size_t memory() const { return num_shards * blocks_per_shard * sizeof(filter_block); }
+    U64 inserted() const;
+    //false positive rate expected at the current load, from the number of insertions
+    double expected_false_positive_rate() const;
+
+private:
+    struct alignas(64) filter_block{
+        std::atomic<U64> words[DEDUP_BLOCK_WORDS];
+    };
+    struct alignas(64) shard{
+        filter_block * blocks;
+        std::atomic<U64> inserted{0};
+    };
+    std::unique_ptr<shard[]> shards;
+    //every shard's blocks, one after another
+    Large_Buffer storage;
+    size_t num_shards;
+    size_t blocks_per_shard;
+
+    inline filter_block & block(U64 zobrist) const{
+        //high bits pick the shard, the low bits the block, so the two stay independent
+        return shards[(zobrist >> 40) % num_shards].blocks[zobrist % blocks_per_shard];
+    }
+};
+
+//reads one fen per line and writes each position the first time it is seen,
+//in input order. threads parse a batch at a time and the batch then goes through
+//the filter in order, so the output does not depend on the thread count
+dedup_stats dedup_fens(std::istream & in, std::ostream & out, Position_Filter & filter, int threads);
+
+#endif
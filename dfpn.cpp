@@ -0,0 +1,231 @@
+//
+//  dfpn.cpp
+//  InvincibleSummer
+//
+
+#include "dfpn.h"
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+#define DFPN_BUCKET_SIZE 2
+#define DFPN_MAX_PV 128
+#define DFPN_NO_LIMIT 0xffff
+
+static inline uint32_t saturating_add(uint32_t a, uint32_t b){
+    return (uint32_t) std::min<uint64_t>((uint64_t) a + b, DFPN_INFINITY);
+}
+
+//plies left for a child, a search without a limit stays without one all the way down
+static inline uint16_t child_remaining(uint16_t remaining){
+    return remaining == DFPN_NO_LIMIT ? remaining : remaining - 1;
+}
+
+DFPN_Solver::DFPN_Solver(size_t megabytes){
+    size_t num_buckets = 1;
+    while(num_buckets * 2 * DFPN_BUCKET_SIZE * sizeof(dfpn_entry) <= megabytes * 1024 * 1024)
+        num_buckets *= 2;
+    if(!memory.allocate(num_buckets * DFPN_BUCKET_SIZE * sizeof(dfpn_entry)))
+        throw std::bad_alloc();
+    table = memory.as<dfpn_entry>();
+    bucket_mask = num_buckets - 1;
+    clear();
+}
+
+//an all zero entry is an empty one
+void DFPN_Solver::clear(){
+    memory.first_touch(1);
+}
+
+//a mate is reusable when it fits in the plies left, anything else only when searched
+//with at least as many plies left. unfinished values need the same number of plies
+//left under a limit, and without one they are shared by every depth
+bool DFPN_Solver::lookup(U64 key, uint16_t remaining, uint32_t & phi, uint32_t & delta, uint16_t & distance){
+    dfpn_entry * bucket = &table[(key & bucket_mask) * DFPN_BUCKET_SIZE];
+    for(int i = 0; i < DFPN_BUCKET_SIZE; i++){
+        if(bucket[i].key != key || !(bucket[i].phi || bucket[i].delta))
+            continue;
+        bool solved = !bucket[i].phi || !bucket[i].delta;
+        bool attacker_wins = (board->current_side == attacker) == !bucket[i].phi;
+        if(solved && attacker_wins ? bucket[i].distance <= remaining
+           : solved ? bucket[i].remaining >= remaining : bucket[i].remaining == remaining){
+            phi = bucket[i].phi;
+            delta = bucket[i].delta;
+            distance = bucket[i].distance;
+            return true;
+        }
+    }
+    return false;
+}
+
+void DFPN_Solver::store(U64 key, uint32_t phi, uint32_t delta, uint32_t work, uint16_t distance, uint16_t remaining){
+    dfpn_entry * bucket = &table[(key & bucket_mask) * DFPN_BUCKET_SIZE];
+    dfpn_entry * replace = &bucket[0];
+    for(int i = 0; i < DFPN_BUCKET_SIZE; i++){
+        if(bucket[i].key == key){
+            replace = &bucket[i];
+            break;
+        }
+        if(bucket[i].work < replace->work)
+            replace = &bucket[i];
+    }
+    *replace = dfpn_entry{key, phi, delta, work, distance, remaining};
+}
+
+int DFPN_Solver::generate_children(uint16_t * moves, U64 * hashes, bool * repeated){
+    uint16_t move_list[256];
+    int num_moves = board->generate_moves(move_list);
+    bool attacking = board->current_side == attacker;
+    check_info info;
+    if(attacking)
+        board->compute_check_info(info);
+    int count = 0;
+    for(int i = 0; i < num_moves; i++){
+        if(attacking && !board->gives_check(move_list[i], info))
+            continue;
+        board->make_move(move_list[i]);
+        if(!board->is_move_legal()){
+            moves[count] = move_list[i];
+            hashes[count] = board->zobrist_hash;
+            //the same position with the same side to move earlier on this path
+            repeated[count] = false;
+            for(int j = board->ply - 2; j >= root_ply; j -= 2){
+                if(board->hash_history[j] == board->zobrist_hash){
+                    repeated[count] = true;
+                    break;
+                }
+            }
+            count++;
+        }
+        board->unmake_move(move_list[i]);
+    }
+    return count;
+}
+
+void DFPN_Solver::child_values(U64 hash, bool repeated, uint16_t remaining, uint32_t & phi, uint32_t & delta, uint16_t & distance){
+    distance = 0;
+    if(repeated){
+        //a repetition is a draw, lost for the attacker, the child's side to move is the other one
+        bool attacker_to_move = board->current_side != attacker;
+        phi = attacker_to_move ? DFPN_INFINITY : 0;
+        delta = attacker_to_move ? 0 : DFPN_INFINITY;
+        return;
+    }
+    //lookup judges the entry from the child's side to move
+    board->current_side ^= 1;
+    bool found = lookup(hash, remaining, phi, delta, distance);
+    board->current_side ^= 1;
+    if(!found)
+        phi = delta = 1;
+}
+
+void DFPN_Solver::mid(uint32_t phi_threshold, uint32_t delta_threshold, uint16_t remaining){
+    nodes++;
+    U64 start_nodes = nodes;
+    U64 key = board->zobrist_hash;
+    bool attacking = board->current_side == attacker;
+    uint16_t moves[256];
+    U64 hashes[256];
+    bool repeated[256];
+    int count = generate_children(moves, hashes, repeated);
+    //no checks left for the attacker, or the defender is mated
+    if(!count){
+        store(key, DFPN_INFINITY, 0, 1, 0, remaining);
+        return;
+    }
+    //out of plies with moves still to play, the attack has failed
+    if(!remaining){
+        store(key, attacking ? DFPN_INFINITY : 0, attacking ? 0 : DFPN_INFINITY, 1, 0, remaining);
+        return;
+    }
+
+    while(true){
+        //phi is the smallest child delta. delta is the largest child phi plus one for
+        //every other unsolved child, a plain sum counts positions reached through
+        //transpositions and cycles many times over and never stops growing
+        uint32_t phi = DFPN_INFINITY, delta = 0, second_delta = DFPN_INFINITY, best_phi = 0, max_phi = 0;
+        int best = 0, unsolved = 0;
+        uint16_t distance = attacking ? 0xffff : 0;
+        for(int i = 0; i < count; i++){
+            uint32_t child_phi, child_delta;
+            uint16_t child_distance;
+            child_values(hashes[i], repeated[i], child_remaining(remaining), child_phi, child_delta, child_distance);
+            max_phi = std::max(max_phi, child_phi);
+            unsolved += child_phi != 0;
+            if(child_delta < phi){
+                second_delta = phi;
+                phi = child_delta;
+                best = i;
+                best_phi = child_phi;
+            }else if(child_delta < second_delta){
+                second_delta = child_delta;
+            }
+            //mate distance, the attacker takes the quickest proven child, the defender the slowest
+            if(attacking && !child_delta)
+                distance = std::min<uint16_t>(distance, child_distance + 1);
+            if(!attacking)
+                distance = std::max<uint16_t>(distance, child_distance + 1);
+        }
+        delta = max_phi ? saturating_add(max_phi, unsolved - 1) : 0;
+        if(phi >= phi_threshold || delta >= delta_threshold || (max_nodes && nodes >= max_nodes)){
+            bool attacker_wins = attacking ? !phi : !delta;
+            store(key, phi, delta, (uint32_t) std::min<U64>(nodes - start_nodes + 1, 0xffffffffu), attacker_wins ? distance : 0, remaining);
+            return;
+        }
+        uint32_t child_phi_threshold = (uint32_t) std::min<uint64_t>((uint64_t) delta_threshold + best_phi - delta, DFPN_INFINITY);
+        //1 + epsilon, a child is left when it gets a quarter worse than the runner up
+        uint32_t child_delta_threshold = std::min(phi_threshold, saturating_add(second_delta, second_delta / 4 + 1));
+        board->make_move(moves[best]);
+        mid(child_phi_threshold, child_delta_threshold, child_remaining(remaining));
+        board->unmake_move(moves[best]);
+    }
+}
+
+dfpn_result DFPN_Solver::solve(const Bitboard_Gen & root, U64 node_limit, int max_plies){
+    auto start = std::chrono::steady_clock::now();
+    board.reset(new Bitboard_Gen(root));
+    attacker = board->current_side;
+    root_ply = board->ply;
+    nodes = 0;
+    max_nodes = node_limit;
+    uint16_t remaining = max_plies > 0 ? (uint16_t) std::min(max_plies, DFPN_NO_LIMIT - 1) : DFPN_NO_LIMIT;
+    mid(DFPN_INFINITY, DFPN_INFINITY, remaining);
+
+    dfpn_result result;
+    result.nodes = nodes;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint32_t phi = 1, delta = 1;
+    uint16_t distance = 0;
+    lookup(board->zobrist_hash, remaining, phi, delta, distance);
+    result.status = !phi ? DFPN_PROVEN : !delta ? DFPN_DISPROVEN : DFPN_UNKNOWN;
+    if(result.status != DFPN_PROVEN)
+        return result;
+    result.mate_plies = distance;
+
+    //walk the proof: the attacker's fastest proven check, the defender's slowest reply
+    while(result.pv.size() < DFPN_MAX_PV){
+        uint16_t moves[256];
+        U64 hashes[256];
+        bool repeated[256];
+        int count = generate_children(moves, hashes, repeated);
+        bool attacking = board->current_side == attacker;
+        int chosen = -1;
+        uint16_t chosen_distance = 0;
+        for(int i = 0; i < count; i++){
+            uint32_t child_phi, child_delta;
+            uint16_t child_distance;
+            child_values(hashes[i], repeated[i], child_remaining(remaining), child_phi, child_delta, child_distance);
+            bool proven = attacking ? !child_delta : !child_phi;
+            if(proven && (chosen < 0 || (attacking ? child_distance < chosen_distance : child_distance > chosen_distance))){
+                chosen = i;
+                chosen_distance = child_distance;
+            }
+        }
+        if(chosen < 0)
+            break;
+        result.pv.push_back(moves[chosen]);
+        board->make_move(moves[chosen]);
+        remaining = child_remaining(remaining);
+    }
+    return result;
+}
@@ -0,0 +1,71 @@
+//
+//  dfpn.h
+//  InvincibleSummer
+//
+//  Depth-first proof-number search for forced mates by continuous checks. The
+//  attacker, the side to move at the root, only tries moves that give check,
+//  found with gives_check; the defender tries every legal evasion. Proof and
+//  disproof numbers are kept in a hash table keyed on zobrist_hash, and a
+//  position repeating on the current path counts as a failed attack, and so
+//  does running past the ply limit when one is given. Values
+//  are stored from the point of view of the side to move (phi, delta), so one
+//  routine handles both kinds of node.
+//
+#include "bitboard_gen.h"
+#include "large_pages.h"
+#include <memory>
+#include <vector>
+
+#ifndef DFPN
+#define DFPN
+
+#define DFPN_INFINITY 100000000u
+
+#define DFPN_UNKNOWN 0
+#define DFPN_PROVEN 1
+#define DFPN_DISPROVEN 2
+
+struct dfpn_entry{
+    U64 key;
+    uint32_t phi;
+    uint32_t delta;
+    uint32_t work;  //nodes spent below the entry, the cheaper one is replaced
+    uint16_t distance;  //plies to mate when the attacker wins here
+    uint16_t remaining;  //plies left under the limit when the entry was searched
+};
+
+struct dfpn_result{
+    int status = DFPN_UNKNOWN;
+    int mate_plies = 0;  //length of the proof found, not always the shortest mate
+    U64 nodes = 0;
+    double seconds = 0;
+    std::vector<uint16_t> pv;
+};
+
+class DFPN_Solver{
+public:
+    DFPN_Solver(size_t megabytes);
+    void clear();
+    //gives up as unknown after max_nodes, 0 for no limit. with max_plies set
+    //only mates within that many plies are proven
+    dfpn_result solve(const Bitboard_Gen & root, U64 max_nodes, int max_plies = 0);
+
+private:
+    Large_Buffer memory;
+    dfpn_entry * table;
+    size_t bucket_mask;
+    std::unique_ptr<Bitboard_Gen> board;
+    int attacker;
+    int root_ply;
+    U64 nodes;
+    U64 max_nodes;
+
+    void mid(uint32_t phi_threshold, uint32_t delta_threshold, uint16_t remaining);
+    int generate_children(uint16_t * moves, U64 * hashes, bool * repeated);
+    //phi and delta of a child, from the point of view of the side to move there
+    void child_values(U64 hash, bool repeated, uint16_t remaining, uint32_t & phi, uint32_t & delta, uint16_t & distance);
+    bool lookup(U64 key, uint16_t remaining, uint32_t & phi, uint32_t & delta, uint16_t & distance);
+    void store(U64 key, uint32_t phi, uint32_t delta, uint32_t work, uint16_t distance, uint16_t remaining);
+};
+
+#endif
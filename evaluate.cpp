@@ -0,0 +1,108 @@
+//
+//  evaluate.cpp
+//  InvincibleSummer
+//
+
+#include "evaluate.h"
+
+//piece square tables, written from white's side with the 8th rank on top,
+//so a white piece on square s reads index s ^ 56 and a black piece reads s
+static const int pawn_table[64] = {
+     0,  0,  0,  0,  0,  0,  0,  0,
+    50, 50, 50, 50, 50, 50, 50, 50,
+    10, 10, 20, 30, 30, 20, 10, 10,
+     5,  5, 10, 25, 25, 10,  5,  5,
+     0,  0,  0, 20, 20,  0,  0,  0,
+     5, -5,-10,  0,  0,-10, -5,  5,
+     5, 10, 10,-20,-20, 10, 10,  5,
+     0,  0,  0,  0,  0,  0,  0,  0
+};
+static const int knight_table[64] = {
+    -50,-40,-30,-30,-30,-30,-40,-50,
+    -40,-20,  0,  0,  0,  0,-20,-40,
+    -30,  0, 10, 15, 15, 10,  0,-30,
+    -30,  5, 15, 20, 20, 15,  5,-30,
+    -30,  0, 15, 20, 20, 15,  0,-30,
+    -30,  5, 10, 15, 15, 10,  5,-30,
+    -40,-20,  0,  5,  5,  0,-20,-40,
+    -50,-40,-30,-30,-30,-30,-40,-50
+};
+static const int bishop_table[64] = {
+    -20,-10,-10,-10,-10,-10,-10,-20,
+    -10,  0,  0,  0,  0,  0,  0,-10,
+    -10,  0,  5, 10, 10,  5,  0,-10,
+    -10,  5,  5, 10, 10,  5,  5,-10,
+    -10,  0, 10, 10, 10, 10,  0,-10,
+    -10, 10, 10, 10, 10, 10, 10,-10,
+    -10,  5,  0,  0,  0,  0,  5,-10,
+    -20,-10,-10,-10,-10,-10,-10,-20
+};
+static const int rook_table[64] = {
+     0,  0,  0,  0,  0,  0,  0,  0,
+     5, 10, 10, 10, 10, 10, 10,  5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+     0,  0,  0,  5,  5,  0,  0,  0
+};
+static const int queen_table[64] = {
+    -20,-10,-10, -5, -5,-10,-10,-20,
+    -10,  0,  0,  0,  0,  0,  0,-10,
+    -10,  0,  5,  5,  5,  5,  0,-10,
+     -5,  0,  5,  5,  5,  5,  0, -5,
+      0,  0,  5,  5,  5,  5,  0, -5,
+    -10,  5,  5,  5,  5,  5,  0,-10,
+    -10,  0,  5,  0,  0,  0,  0,-10,
+    -20,-10,-10, -5, -5,-10,-10,-20
+};
+static const int king_mg_table[64] = {
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -20,-30,-30,-40,-40,-30,-30,-20,
+    -10,-20,-20,-20,-20,-20,-20,-10,
+     20, 20,  0,  0,  0,  0, 20, 20,
+     20, 30, 10,  0,  0, 10, 30, 20
+};
+static const int king_eg_table[64] = {
+    -50,-40,-30,-20,-20,-30,-40,-50,
+    -30,-20,-10,  0,  0,-10,-20,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-30,  0,  0,  0,  0,-30,-30,
+    -50,-30,-30,-30,-30,-30,-30,-50
+};
+
+static const int * piece_tables[8] = {nullptr, nullptr, pawn_table, bishop_table, knight_table,
+    rook_table, queen_table, nullptr};
+//game phase weight per piece type, 24 at the start position
+static const int phase_weights[8] = {0, 0, 0, 1, 1, 2, 4, 0};
+
+int evaluate(Bitboard_Gen & board){
+    int score[2] = {0, 0};
+    int phase = 0;
+    U64 pieces = (board.bitboards[WHITE] | board.bitboards[BLACK]) & ~board.bitboards[KING_BOARD];
+    while(pieces){
+        int square = board.pop_lsb(&pieces);
+        int piece = board.mailbox[square];
+        int color = piece & 1;
+        int type = piece >> 1;
+        int table_index = color == WHITE ? square ^ 56 : square;
+        score[color] += piece_values[type] + piece_tables[type][table_index];
+        phase += phase_weights[type];
+    }
+    if(phase > 24)
+        phase = 24;
+    for(int color = WHITE; color <= BLACK; color++){
+        int king_square = board.get_square_index(board.bitboards[color] & board.bitboards[KING_BOARD]);
+        int table_index = color == WHITE ? king_square ^ 56 : king_square;
+        score[color] += (king_mg_table[table_index] * phase + king_eg_table[table_index] * (24 - phase)) / 24;
+    }
+    int white_score = score[WHITE] - score[BLACK];
+    return board.current_side == WHITE ? white_score : -white_score;
+}
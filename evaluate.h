@@ -0,0 +1,19 @@
+//
+//  evaluate.h
+//  InvincibleSummer
+//
+//  Hand written material and piece square evaluation, used by the search
+//  whenever no network is loaded.
+//
+#include "bitboard_gen.h"
+
+#ifndef EVALUATE
+#define EVALUATE
+
+//indexed by the piece type board index, PAWN_BOARD through KING_BOARD
+constexpr int piece_values[8] = {0, 0, 100, 330, 320, 500, 900, 0};
+
+//score in centipawns from the side to move's point of view
+int evaluate(Bitboard_Gen & board);
+
+#endif
@@ -0,0 +1,202 @@
+//
+//  geometry.h
+//  InvincibleSummer
+//
+//  Board geometry generated by constexpr functions at compile time: leaper
+//  attacks, rays per direction, and the 64x64 between, line and distance
+//  tables. The hand written lookups in Bitboard_Gen are checked against the
+//  generated ones with static_asserts at the bottom, so a typo in either fails
+//  the build.
+//
+#include "bitboard_gen.h"
+#include <array>
+
+#ifndef GEOMETRY
+#define GEOMETRY
+
+//clockwise from north, white's point of view
+#define DIRECTION_NORTH 0
+#define DIRECTION_NORTH_EAST 1
+#define DIRECTION_EAST 2
+#define DIRECTION_SOUTH_EAST 3
+#define DIRECTION_SOUTH 4
+#define DIRECTION_SOUTH_WEST 5
+#define DIRECTION_WEST 6
+#define DIRECTION_NORTH_WEST 7
+
+inline constexpr int direction_file_step[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+inline constexpr int direction_rank_step[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+//0 when the file or rank is off the board
+constexpr U64 square_bit(int file, int rank){
+    return (file >= 0 && file < 8 && rank >= 0 && rank < 8) ? 1ULL << (rank * 8 + file) : 0;
+}
+
+template <size_t N>
+constexpr std::array<U64, 64> make_leaper_table(const int (&file_steps)[N], const int (&rank_steps)[N]){
+    std::array<U64, 64> table{};
+    for(int square = 0; square < 64; square++){
+        for(size_t i = 0; i < N; i++)
+            table[square] |= square_bit(square % 8 + file_steps[i], square / 8 + rank_steps[i]);
+    }
+    return table;
+}
+
+inline constexpr int king_file_steps[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+inline constexpr int king_rank_steps[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+inline constexpr int knight_file_steps[8] = {1, 2, 2, 1, -1, -2, -2, -1};
+inline constexpr int knight_rank_steps[8] = {2, 1, -1, -2, -2, -1, 1, 2};
+inline constexpr int white_pawn_file_steps[2] = {-1, 1};
+inline constexpr int white_pawn_rank_steps[2] = {1, 1};
+inline constexpr int black_pawn_file_steps[2] = {-1, 1};
+inline constexpr int black_pawn_rank_steps[2] = {-1, -1};
+
+inline constexpr std::array<U64, 64> king_attacks = make_leaper_table(king_file_steps, king_rank_steps);
+inline constexpr std::array<U64, 64> knight_attacks = make_leaper_table(knight_file_steps, knight_rank_steps);
+inline constexpr std::array<std::array<U64, 64>, 2> pawn_attacks = {
+    make_leaper_table(white_pawn_file_steps, white_pawn_rank_steps),
+    make_leaper_table(black_pawn_file_steps, black_pawn_rank_steps),
+};
+
+//neighbours on the same rank of a pawn that just pushed two squares
+constexpr std::array<U64, 64> make_ep_neighbour_table(){
+    std::array<U64, 64> table{};
+    for(int square = 24; square < 40; square++)
+        table[square] = square_bit(square % 8 - 1, square / 8) | square_bit(square % 8 + 1, square / 8);
+    return table;
+}
+inline constexpr std::array<U64, 64> ep_neighbours = make_ep_neighbour_table();
+
+//squares from the origin to the edge in one direction, origin excluded
+constexpr std::array<std::array<U64, 64>, 8> make_ray_table(){
+    std::array<std::array<U64, 64>, 8> table{};
+    for(int direction = 0; direction < 8; direction++){
+        for(int square = 0; square < 64; square++){
+            int file = square % 8 + direction_file_step[direction];
+            int rank = square / 8 + direction_rank_step[direction];
+            for(; square_bit(file, rank); file += direction_file_step[direction], rank += direction_rank_step[direction])
+                table[direction][square] |= square_bit(file, rank);
+        }
+    }
+    return table;
+}
+inline constexpr std::array<std::array<U64, 64>, 8> rays = make_ray_table();
+
+//strictly between two squares sharing a line, 0 otherwise
+constexpr std::array<std::array<U64, 64>, 64> make_between_table(){
+    std::array<std::array<U64, 64>, 64> table{};
+    for(int from = 0; from < 64; from++){
+        for(int direction = 0; direction < 8; direction++){
+            U64 path = 0;
+            int file = from % 8 + direction_file_step[direction];
+            int rank = from / 8 + direction_rank_step[direction];
+            for(; square_bit(file, rank); file += direction_file_step[direction], rank += direction_rank_step[direction]){
+                table[from][rank * 8 + file] = path;
+                path |= square_bit(file, rank);
+            }
+        }
+    }
+    return table;
+}
+inline constexpr std::array<std::array<U64, 64>, 64> between = make_between_table();
+
+//the whole rank, file or diagonal through two squares, 0 if they share none
+constexpr std::array<std::array<U64, 64>, 64> make_line_table(){
+    std::array<std::array<U64, 64>, 64> table{};
+    for(int from = 0; from < 64; from++){
+        for(int direction = 0; direction < 8; direction++){
+            U64 full = rays[direction][from] | rays[(direction + 4) % 8][from] | (1ULL << from);
+            U64 targets = rays[direction][from];
+            for(int to = 0; to < 64; to++){
+                if(targets & (1ULL << to))
+                    table[from][to] = full;
+            }
+        }
+    }
+    return table;
+}
+inline constexpr std::array<std::array<U64, 64>, 64> line = make_line_table();
+
+//king steps between two squares
+constexpr std::array<std::array<uint8_t, 64>, 64> make_distance_table(){
+    std::array<std::array<uint8_t, 64>, 64> table{};
+    for(int from = 0; from < 64; from++){
+        for(int to = 0; to < 64; to++){
+            int files = from % 8 > to % 8 ? from % 8 - to % 8 : to % 8 - from % 8;
+            int ranks = from / 8 > to / 8 ? from / 8 - to / 8 : to / 8 - from / 8;
+            table[from][to] = (uint8_t) (files > ranks ? files : ranks);
+        }
+    }
+    return table;
+}
+inline constexpr std::array<std::array<uint8_t, 64>, 64> distance = make_distance_table();
+
+template <typename T, typename U, size_t N>
+constexpr bool tables_equal(const std::array<T, N> & generated, const U (&hand_written)[N]){
+    for(size_t i = 0; i < N; i++){
+        if(generated[i] != (T) hand_written[i])
+            return false;
+    }
+    return true;
+}
+
+//line masks and square indices of the hand written tables, rebuilt from rays
+constexpr std::array<U64, 8> make_rank_masks(){
+    std::array<U64, 8> masks{};
+    for(int rank = 0; rank < 8; rank++)
+        masks[rank] = line[rank * 8][rank * 8 + 1];
+    return masks;
+}
+constexpr std::array<U64, 8> make_file_masks(){
+    std::array<U64, 8> masks{};
+    for(int file = 0; file < 8; file++)
+        masks[file] = line[file][file + 8];
+    return masks;
+}
+//diagonals run a1-h8 and are numbered 7 - file + rank, antidiagonals file + rank
+constexpr std::array<U64, 15> make_diagonal_masks(bool anti){
+    std::array<U64, 15> masks{};
+    for(int square = 0; square < 64; square++)
+        masks[anti ? square % 8 + square / 8 : 7 - square % 8 + square / 8] |= 1ULL << square;
+    return masks;
+}
+constexpr std::array<int, 64> make_square_index(int kind){
+    std::array<int, 64> index{};
+    for(int square = 0; square < 64; square++){
+        int file = square % 8, rank = square / 8;
+        index[square] = kind == 0 ? rank : kind == 1 ? file : kind == 2 ? 7 - file + rank : file + rank;
+    }
+    return index;
+}
+constexpr std::array<U64, 64> make_occupy_table(){
+    std::array<U64, 64> table{};
+    for(int square = 0; square < 64; square++)
+        table[square] = 1ULL << square;
+    return table;
+}
+
+static_assert(tables_equal(king_attacks, Bitboard_Gen::king_move_lookup), "king_move_lookup");
+static_assert(tables_equal(knight_attacks, Bitboard_Gen::knight_move_lookup), "knight_move_lookup");
+static_assert(tables_equal(pawn_attacks[WHITE], Bitboard_Gen::pawn_capture_lookup[WHITE]), "pawn_capture_lookup white");
+static_assert(tables_equal(pawn_attacks[BLACK], Bitboard_Gen::pawn_capture_lookup[BLACK]), "pawn_capture_lookup black");
+static_assert(tables_equal(ep_neighbours, Bitboard_Gen::ep_target_lookup), "ep_target_lookup");
+static_assert(tables_equal(make_occupy_table(), Bitboard_Gen::occupy_square), "occupy_square");
+static_assert(tables_equal(make_rank_masks(), Bitboard_Gen::rank_masks), "rank_masks");
+static_assert(tables_equal(make_file_masks(), Bitboard_Gen::file_masks), "file_masks");
+static_assert(tables_equal(make_diagonal_masks(false), Bitboard_Gen::diagonal_masks), "diagonal_masks");
+static_assert(tables_equal(make_diagonal_masks(true), Bitboard_Gen::antidiagonal_masks), "antidiagonal_masks");
+static_assert(tables_equal(make_square_index(0), Bitboard_Gen::source_to_rank), "source_to_rank");
+static_assert(tables_equal(make_square_index(1), Bitboard_Gen::source_to_file), "source_to_file");
+static_assert(tables_equal(make_square_index(2), Bitboard_Gen::source_to_diagonal), "source_to_diagonal");
+static_assert(tables_equal(make_square_index(3), Bitboard_Gen::source_to_antidiagonal), "source_to_antidiagonal");
+
+//a few spot checks of the new tables
+static_assert(between[0][63] == 0x0040201008040200ULL, "between a1-h8");
+static_assert(between[0][7] == 0x7eULL, "between a1-h1");
+static_assert(between[0][10] == 0, "between unaligned");
+static_assert(line[9][18] == 0x8040201008040201ULL, "line b2-c3");
+static_assert(line[0][10] == 0, "line unaligned");
+static_assert(rays[DIRECTION_NORTH][0] == 0x0101010101010100ULL, "ray north from a1");
+static_assert(distance[0][63] == 7 && distance[0][10] == 2, "distance");
+
+#endif
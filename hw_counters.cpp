@@ -0,0 +1,104 @@
+//
+//  hw_counters.cpp
+//  InvincibleSummer
+//
+
+#include "hw_counters.h"
+
+#if defined(__linux__)
+    #include <cerrno>
+    #include <cstring>
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+const char * Hardware_Counters::name(int counter){
+    static const char * names[HW_NUM_COUNTERS] = {"cycles", "instructions", "branch-misses", "L1D-misses", "dTLB-misses"};
+    return names[counter];
+}
+
+#if defined(__linux__)
+
+static int open_counter(uint32_t type, uint64_t config){
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    //user space only, which a perf_event_paranoid of 2 still allows
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+Hardware_Counters::Hardware_Counters(){
+    const uint32_t types[HW_NUM_COUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE};
+    const uint64_t configs[HW_NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    };
+    for(int i = 0; i < HW_NUM_COUNTERS; i++){
+        fds[i] = open_counter(types[i], configs[i]);
+        if(fds[i] < 0 && open_error.empty())
+            open_error = std::string(name(i)) + ": " + strerror(errno);
+    }
+}
+
+Hardware_Counters::~Hardware_Counters(){
+    for(int i = 0; i < HW_NUM_COUNTERS; i++){
+        if(fds[i] >= 0)
+            close(fds[i]);
+    }
+}
+
+void Hardware_Counters::start(){
+    for(int i = 0; i < HW_NUM_COUNTERS; i++){
+        if(fds[i] < 0)
+            continue;
+        ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+hw_sample Hardware_Counters::stop(){
+    hw_sample sample;
+    for(int i = 0; i < HW_NUM_COUNTERS; i++){
+        if(fds[i] < 0)
+            continue;
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        sample.valid[i] = read(fds[i], &sample.values[i], sizeof(uint64_t)) == sizeof(uint64_t);
+    }
+    return sample;
+}
+
+#else
+
+Hardware_Counters::Hardware_Counters() : open_error("perf_event_open is Linux only"){
+    for(int i = 0; i < HW_NUM_COUNTERS; i++)
+        fds[i] = -1;
+}
+
+Hardware_Counters::~Hardware_Counters(){}
+
+void Hardware_Counters::start(){}
+
+hw_sample Hardware_Counters::stop(){
+    return hw_sample();
+}
+
+#endif
+
+bool Hardware_Counters::available() const{
+    for(int i = 0; i < HW_NUM_COUNTERS; i++){
+        if(fds[i] >= 0)
+            return true;
+    }
+    return false;
+}
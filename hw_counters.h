@@ -0,0 +1,50 @@
+//
+//  hw_counters.h
+//  InvincibleSummer
+//
+//  Linux perf_event_open counters for the benchmarks. Each counter is opened on
+//  its own, so one the kernel or a VM does not expose is skipped while the rest
+//  still count. On other platforms nothing opens and the benchmarks run as usual.
+//
+#include <cstdint>
+#include <string>
+
+#ifndef HW_COUNTERS
+#define HW_COUNTERS
+
+#define HW_CYCLES 0
+#define HW_INSTRUCTIONS 1
+#define HW_BRANCH_MISSES 2
+#define HW_L1D_MISSES 3
+#define HW_DTLB_MISSES 4
+#define HW_NUM_COUNTERS 5
+
+struct hw_sample{
+    uint64_t values[HW_NUM_COUNTERS] = {};
+    bool valid[HW_NUM_COUNTERS] = {};
+};
+
+class Hardware_Counters{
+public:
+    //counts user space of the calling thread and of threads it starts afterwards
+    Hardware_Counters();
+    ~Hardware_Counters();
+    Hardware_Counters(const Hardware_Counters &) = delete;
+    Hardware_Counters & operator=(const Hardware_Counters &) = delete;
+
+    bool available() const;
+    //why the first counter failed to open, empty if they all opened
+    const std::string & error() const { return open_error; }
+
+    void start();
+    //threads started after start() must be joined before stop() to be counted
+    hw_sample stop();
+
+    static const char * name(int counter);
+
+private:
+    int fds[HW_NUM_COUNTERS];
+    std::string open_error;
+};
+
+#endif
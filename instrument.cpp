@@ -0,0 +1,127 @@
+//
+//  instrument.cpp
+//  InvincibleSummer
+//
+
+#include "instrument.h"
+
+#ifdef INSTRUMENT
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+thread_local instrument_counters * instrument_block = nullptr;
+
+//blocks outlive their threads so the counts of joined searchers still add up at exit
+static std::mutex registry_mutex;
+static std::vector<instrument_counters *> registry;
+
+static const char * piece_names[8] = {"", "", "pawn", "bishop", "knight", "rook", "queen", "king"};
+static const char * flag_names[16] = {"quiet", "double_push", "king_castle", "queen_castle", "capture", "en_passant", "", "",
+    "promo_b", "promo_n", "promo_r", "promo_q", "promo_capture_b", "promo_capture_n", "promo_capture_r", "promo_capture_q"};
+static const char * stage_names[INSTR_NUM_STAGES] = {"attacked_squares", "pawns", "castles", "knights", "king", "diagonal", "orthogonal"};
+
+instrument_counters * instrument_register(){
+    instrument_counters * block = new instrument_counters();
+    memset(block, 0, sizeof(*block));
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    if(registry.empty())
+        atexit(instrument_dump);
+    registry.push_back(block);
+    return block;
+}
+
+static instrument_counters sum_counters(){
+    instrument_counters total;
+    memset(&total, 0, sizeof(total));
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    //every field is a uint64_t, so the blocks add up word by word
+    const int words = sizeof(instrument_counters) / sizeof(uint64_t);
+    for(instrument_counters * block : registry){
+        for(int i = 0; i < words; i++)
+            ((uint64_t *) &total)[i] += ((const uint64_t *) block)[i];
+    }
+    return total;
+}
+
+static double ratio(uint64_t part, uint64_t whole){
+    return whole ? (double) part / (double) whole : 0.0;
+}
+
+static void dump_json(FILE * out, const instrument_counters & total){
+    fprintf(out, "{\n  \"moves_by_piece\": {");
+    for(int piece = 2, first = 1; piece < 8; piece++, first = 0)
+        fprintf(out, "%s\"%s\": %llu", first ? "" : ", ", piece_names[piece], (unsigned long long) total.moves_by_piece[piece]);
+    fprintf(out, "},\n  \"moves_by_flag\": {");
+    for(int flag = 0, first = 1; flag < 16; flag++){
+        if(!*flag_names[flag])
+            continue;
+        fprintf(out, "%s\"%s\": %llu", first ? "" : ", ", flag_names[flag], (unsigned long long) total.moves_by_flag[flag]);
+        first = 0;
+    }
+    fprintf(out, "},\n  \"legality_checks\": %llu,\n  \"illegal_moves\": %llu,\n  \"rejection_rate\": %.6f,\n",
+            (unsigned long long) total.legality_checks, (unsigned long long) (total.legality_checks - total.legal_moves),
+            ratio(total.legality_checks - total.legal_moves, total.legality_checks));
+    fprintf(out, "  \"attacked_square_calls\": %llu,\n  \"generate_calls\": %llu,\n",
+            (unsigned long long) total.attacked_square_calls, (unsigned long long) total.generate_calls);
+    const char * names[2] = {"make_by_flag", "unmake_by_flag"};
+    const uint64_t * counts[2] = {total.make_by_flag, total.unmake_by_flag};
+    for(int table = 0; table < 2; table++){
+        fprintf(out, "  \"%s\": {", names[table]);
+        for(int flag = 0, first = 1; flag < 16; flag++){
+            if(!*flag_names[flag])
+                continue;
+            fprintf(out, "%s\"%s\": %llu", first ? "" : ", ", flag_names[flag], (unsigned long long) counts[table][flag]);
+            first = 0;
+        }
+        fprintf(out, "},\n");
+    }
+    fprintf(out, "  \"stage_samples\": %llu,\n  \"cycles_per_call\": {", (unsigned long long) total.stage_samples);
+    for(int stage = 0; stage < INSTR_NUM_STAGES; stage++)
+        fprintf(out, "%s\"%s\": %.1f", stage ? ", " : "", stage_names[stage], ratio(total.stage_cycles[stage], total.stage_samples));
+    fprintf(out, "}\n}\n");
+}
+
+static void dump_table(FILE * out, const instrument_counters & total){
+    uint64_t all_moves = 0;
+    for(int piece = 0; piece < 8; piece++)
+        all_moves += total.moves_by_piece[piece];
+    fprintf(out, "\n%-20s %16s %8s\n", "moves by piece", "count", "share");
+    for(int piece = 2; piece < 8; piece++)
+        fprintf(out, "%-20s %16llu %7.2f%%\n", piece_names[piece], (unsigned long long) total.moves_by_piece[piece],
+                100 * ratio(total.moves_by_piece[piece], all_moves));
+    fprintf(out, "\n%-20s %16s %16s %16s\n", "by flag", "generated", "made", "unmade");
+    for(int flag = 0; flag < 16; flag++){
+        if(!*flag_names[flag])
+            continue;
+        fprintf(out, "%-20s %16llu %16llu %16llu\n", flag_names[flag], (unsigned long long) total.moves_by_flag[flag],
+                (unsigned long long) total.make_by_flag[flag], (unsigned long long) total.unmake_by_flag[flag]);
+    }
+    fprintf(out, "\nlegality checks %llu, rejected %llu (%.2f%%)\n", (unsigned long long) total.legality_checks,
+            (unsigned long long) (total.legality_checks - total.legal_moves),
+            100 * ratio(total.legality_checks - total.legal_moves, total.legality_checks));
+    fprintf(out, "generate_moves calls %llu, generate_attacked_squares calls %llu\n",
+            (unsigned long long) total.generate_calls, (unsigned long long) total.attacked_square_calls);
+    fprintf(out, "\n%-20s %16s  (%llu sampled calls)\n", "generator stage", "cycles/call", (unsigned long long) total.stage_samples);
+    for(int stage = 0; stage < INSTR_NUM_STAGES; stage++)
+        fprintf(out, "%-20s %16.1f\n", stage_names[stage], ratio(total.stage_cycles[stage], total.stage_samples));
+}
+
+void instrument_dump(){
+    instrument_counters total = sum_counters();
+    const char * json_path = getenv("INSTRUMENT_JSON");
+    if(json_path && *json_path){
+        FILE * out = fopen(json_path, "w");
+        if(out){
+            dump_json(out, total);
+            fclose(out);
+            return;
+        }
+    }
+    dump_table(stderr, total);
+}
+
+#endif
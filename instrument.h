@@ -0,0 +1,101 @@
+//
+//  instrument.h
+//  InvincibleSummer
+//
+//  Hot path counters, compiled in with -DINSTRUMENT and to nothing otherwise.
+//  Every thread counts into its own block, the blocks are summed at exit and
+//  printed to stderr as a table, or written as JSON to the file named by the
+//  INSTRUMENT_JSON environment variable.
+//
+#include <cstdint>
+
+#ifndef INSTRUMENTATION
+#define INSTRUMENTATION
+
+//generate_moves stages timed with the cycle counter
+#define INSTR_STAGE_ATTACKS 0
+#define INSTR_STAGE_PAWNS 1
+#define INSTR_STAGE_CASTLES 2
+#define INSTR_STAGE_KNIGHTS 3
+#define INSTR_STAGE_KING 4
+#define INSTR_STAGE_DIAGONAL 5
+#define INSTR_STAGE_ORTHOGONAL 6
+#define INSTR_NUM_STAGES 7
+
+//one generate_moves call in 64 is timed, reading the counter costs more than some stages
+#define INSTR_SAMPLE_MASK 63
+
+#ifdef INSTRUMENT
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#else
+    #include <chrono>
+#endif
+
+struct instrument_counters{
+    uint64_t moves_by_piece[8];
+    uint64_t moves_by_flag[16];
+    uint64_t legality_checks;
+    uint64_t legal_moves;
+    uint64_t attacked_square_calls;
+    uint64_t make_by_flag[16];
+    uint64_t unmake_by_flag[16];
+    uint64_t generate_calls;
+    uint64_t stage_samples;
+    uint64_t stage_cycles[INSTR_NUM_STAGES];
+};
+
+extern thread_local instrument_counters * instrument_block;
+//allocates and registers the calling thread's block, the first call also registers the dump
+instrument_counters * instrument_register();
+void instrument_dump();
+
+inline instrument_counters & instrument_local(){
+    if(!instrument_block)
+        instrument_block = instrument_register();
+    return *instrument_block;
+}
+
+inline uint64_t instrument_cycles(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t) std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+//mailbox is the board's, read for the piece on each source square
+inline void instrument_moves(const uint16_t * moves, int num_moves, const int * mailbox){
+    instrument_counters & counters = instrument_local();
+    for(int i = 0; i < num_moves; i++){
+        counters.moves_by_piece[(mailbox[(moves[i] >> 10) & 0x3f] >> 1) & 7]++;
+        counters.moves_by_flag[moves[i] & 0x0f]++;
+    }
+}
+
+#define INSTR_COUNT(field) (instrument_local().field++)
+#define INSTR_COUNT_INDEX(field, index) (instrument_local().field[index]++)
+#define INSTR_MOVES(moves, num_moves, mailbox) instrument_moves(moves, num_moves, mailbox)
+#define INSTR_SAMPLE_BEGIN() \
+    bool instr_sampled = (instrument_local().generate_calls++ & INSTR_SAMPLE_MASK) == 0; \
+    uint64_t instr_last = instr_sampled ? instrument_cycles() : 0; \
+    if(instr_sampled) instrument_local().stage_samples++
+#define INSTR_SAMPLE_STAGE(stage) \
+    if(instr_sampled){ \
+        uint64_t instr_now = instrument_cycles(); \
+        instrument_local().stage_cycles[stage] += instr_now - instr_last; \
+        instr_last = instr_now; \
+    }
+
+#else
+
+#define INSTR_COUNT(field) ((void) 0)
+#define INSTR_COUNT_INDEX(field, index) ((void) 0)
+#define INSTR_MOVES(moves, num_moves, mailbox) ((void) 0)
+#define INSTR_SAMPLE_BEGIN() ((void) 0)
+#define INSTR_SAMPLE_STAGE(stage) ((void) 0)
+
+#endif
+
+#endif
@@ -0,0 +1,110 @@
+//
+//  large_pages.cpp
+//  InvincibleSummer
+//
+
+#include "large_pages.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+    #define LARGE_PAGES_NO_MMAP
+    #include <malloc.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+static std::atomic<bool> use_large_pages{true};
+
+void set_large_pages(bool enabled){
+    use_large_pages.store(enabled);
+}
+
+bool large_pages_enabled(){
+    return use_large_pages.load();
+}
+
+Large_Buffer::~Large_Buffer(){
+    release();
+}
+
+bool Large_Buffer::allocate(size_t size){
+    release();
+    size_t rounded = (std::max<size_t>(size, 1) + LARGE_PAGE_SIZE - 1) / LARGE_PAGE_SIZE * LARGE_PAGE_SIZE;
+#if defined(LARGE_PAGES_NO_MMAP)
+    memory = _aligned_malloc(rounded, LARGE_PAGE_SIZE);
+    kind = LARGE_PAGES_NONE;
+#else
+    void * mapped = MAP_FAILED;
+    kind = LARGE_PAGES_NONE;
+    #if defined(MAP_HUGETLB)
+    //explicit pages only exist if the administrator reserved them, see vm.nr_hugepages
+    if(large_pages_enabled()){
+        mapped = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(mapped != MAP_FAILED)
+            kind = LARGE_PAGES_EXPLICIT;
+    }
+    #endif
+    if(mapped == MAP_FAILED){
+        //a 2 MB aligned start, so the kernel can back the whole range with huge pages
+        size_t padded = rounded + LARGE_PAGE_SIZE;
+        mapped = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(mapped == MAP_FAILED)
+            return false;
+        uintptr_t start = (uintptr_t) mapped;
+        uintptr_t aligned = (start + LARGE_PAGE_SIZE - 1) & ~(uintptr_t) (LARGE_PAGE_SIZE - 1);
+        if(aligned > start)
+            munmap(mapped, aligned - start);
+        if(aligned + rounded < start + padded)
+            munmap((void *) (aligned + rounded), start + padded - aligned - rounded);
+        mapped = (void *) aligned;
+    #if defined(MADV_HUGEPAGE)
+        if(large_pages_enabled() && !madvise(mapped, rounded, MADV_HUGEPAGE))
+            kind = LARGE_PAGES_TRANSPARENT;
+    #endif
+    }
+    memory = mapped;
+#endif
+    if(!memory)
+        return false;
+    bytes = rounded;
+    return true;
+}
+
+void Large_Buffer::release(){
+    if(!memory)
+        return;
+#if defined(LARGE_PAGES_NO_MMAP)
+    _aligned_free(memory);
+#else
+    munmap(memory, bytes);
+#endif
+    memory = nullptr;
+    bytes = 0;
+    kind = LARGE_PAGES_NONE;
+}
+
+void Large_Buffer::first_touch(int threads){
+    //slices are whole pages so no page is first written by two threads
+    size_t pages = bytes / LARGE_PAGE_SIZE;
+    threads = (int) std::max<size_t>(1, std::min<size_t>(threads, pages));
+    auto touch = [this, pages, threads](int index){
+        size_t begin = pages * index / threads * LARGE_PAGE_SIZE;
+        size_t end = pages * (index + 1) / threads * LARGE_PAGE_SIZE;
+        std::memset((char *) memory + begin, 0, end - begin);
+    };
+    std::vector<std::thread> pool;
+    for(int i = 1; i < threads; i++)
+        pool.emplace_back(touch, i);
+    touch(0);
+    for(auto & thread : pool)
+        thread.join();
+}
+
+const char * Large_Buffer::page_kind_name() const{
+    return kind == LARGE_PAGES_EXPLICIT ? "explicit 2 MB pages" : kind == LARGE_PAGES_TRANSPARENT ? "transparent huge pages" : "normal pages";
+}
@@ -0,0 +1,57 @@
+//
+//  large_pages.h
+//  InvincibleSummer
+//
+//  Memory for the big tables. Large_Buffer asks for explicit 2 MB pages with
+//  MAP_HUGETLB first, then for transparent huge pages with madvise, and falls
+//  back to normal pages, so one TLB entry can cover 2 MB of a hash table instead
+//  of 4 KB. Nothing is touched on allocation: first_touch zeroes the buffer with
+//  one thread per slice, and under Linux's default local policy each page lands
+//  on the NUMA node of the thread that wrote it first, which spreads a shared
+//  table over the sockets of the threads that probe it.
+//
+#include <cstddef>
+#include <cstdint>
+
+#ifndef LARGE_PAGES
+#define LARGE_PAGES
+
+#define LARGE_PAGE_SIZE (2 * 1024 * 1024)
+
+#define LARGE_PAGES_NONE 0
+#define LARGE_PAGES_TRANSPARENT 1
+#define LARGE_PAGES_EXPLICIT 2
+
+//process wide, read by every allocation after it is set, on by default
+void set_large_pages(bool enabled);
+bool large_pages_enabled();
+
+class Large_Buffer{
+public:
+    Large_Buffer(){}
+    ~Large_Buffer();
+    Large_Buffer(const Large_Buffer &) = delete;
+    Large_Buffer & operator=(const Large_Buffer &) = delete;
+
+    //frees what was held before, rounds up to whole 2 MB pages. the memory is
+    //not zeroed until first_touch, false when even normal pages are refused
+    bool allocate(size_t bytes);
+    void release();
+    //zeroes the buffer, each thread writing one contiguous slice
+    void first_touch(int threads);
+
+    template <typename T>
+    T * as() const { return (T *) memory; }
+    size_t size() const { return bytes; }
+    //LARGE_PAGES_NONE, LARGE_PAGES_TRANSPARENT or LARGE_PAGES_EXPLICIT
+    int page_kind() const { return kind; }
+    //text for the kind of pages, for info output
+    const char * page_kind_name() const;
+
+private:
+    void * memory = nullptr;
+    size_t bytes = 0;
+    int kind = LARGE_PAGES_NONE;
+};
+
+#endif
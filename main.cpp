@@ -0,0 +1,21 @@
+//
+//  main.cpp
+//  InvincibleSummer
+//
+
+#include "uci.h"
+
+int main(int argc, char ** argv){
+    UCI uci;
+    //arguments run as a single command and exit, e.g. ./engine bench or ./engine go perft 5
+    if(argc > 1){
+        std::string line;
+        for(int i = 1; i < argc; i++)
+            line += std::string(argv[i]) + " ";
+        uci.execute(line);
+        uci.wait_for_worker();
+        return 0;
+    }
+    uci.loop(std::cin);
+    return 0;
+}
@@ -0,0 +1,280 @@
+//
+//  mcts.cpp
+//  InvincibleSummer
+//
+
+#include "mcts.h"
+#include "evaluate.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+MCTS_Node_Pool::MCTS_Node_Pool(size_t megabytes){
+    capacity = std::max<size_t>(megabytes, 1) * 1024 * 1024 / sizeof(mcts_node);
+    nodes.reset(new mcts_node[capacity]);
+}
+
+uint32_t MCTS_Node_Pool::allocate(uint32_t count){
+    size_t first = next.fetch_add(count);
+    if(first + count > capacity)
+        return MCTS_NO_CHILD;
+    return (uint32_t) first;
+}
+
+void MCTS_Node_Pool::reset(){
+    next.store(0);
+}
+
+void MCTS_Static_Evaluator::evaluate(Bitboard_Gen * const * boards, int count, float * values){
+    for(int i = 0; i < count; i++)
+        values[i] = std::tanh(::evaluate(*boards[i]) / 400.0f);
+}
+
+MCTS_Search::MCTS_Search(size_t megabytes, MCTS_Evaluator * eval) : pool(megabytes){
+    set_evaluator(eval);
+}
+
+void MCTS_Search::set_evaluator(MCTS_Evaluator * eval){
+    evaluator = eval ? eval : &static_evaluator;
+}
+
+//captures and promotions get a larger share of the prior than quiet moves
+static float prior_weight(Bitboard_Gen & board, uint16_t move){
+    int flag = move & 0x0f;
+    float weight = 1;
+    if(flag & CAPTURE_FLAG){
+        int victim = flag == EN_PASSANT_FLAG ? PAWN_BOARD : board.mailbox[(move >> 4) & 0x3f] >> 1;
+        weight += 1 + piece_values[victim] / 200.0f;
+    }
+    if((flag & 8) && (flag & 3) == (QUEEN_PROMO_FLAG & 3))
+        weight += 3;
+    return weight;
+}
+
+//two fold repetition since the last capture, counting the game before the root
+static bool repeated(Bitboard_Gen & board){
+    for(int i = board.ply - 2; i >= 0 && i >= board.ply - 100; i -= 2){
+        if(board.game_history[i + 1].captured || board.game_history[i + 2].captured)
+            return false;
+        if(board.hash_history[i] == board.zobrist_hash)
+            return true;
+    }
+    return false;
+}
+
+bool MCTS_Search::expand(Bitboard_Gen & board, uint32_t index){
+    mcts_node & node = pool[index];
+    uint16_t move_list[256];
+    float weights[256];
+    int num_moves = board.generate_moves(move_list);
+    int legal = 0;
+    float total = 0;
+    for(int i = 0; i < num_moves; i++){
+        board.make_move(move_list[i]);
+        bool illegal = board.is_move_legal();
+        board.unmake_move(move_list[i]);
+        if(!illegal){
+            move_list[legal] = move_list[i];
+            weights[legal] = prior_weight(board, move_list[i]);
+            total += weights[legal++];
+        }
+    }
+    //mate is a win for the player who moved into the node
+    if(!legal || (index && repeated(board)) || board.ply >= 390){
+        node.terminal_value = !legal && board.position_in_check() ? 1 : 0;
+        node.state.store(MCTS_TERMINAL, std::memory_order_release);
+        return true;
+    }
+    uint32_t first = pool.allocate(legal);
+    if(first == MCTS_NO_CHILD){
+        node.state.store(MCTS_UNEXPANDED, std::memory_order_release);
+        return false;
+    }
+    for(int i = 0; i < legal; i++){
+        mcts_node & child = pool[first + i];
+        child.value_sum.store(0, std::memory_order_relaxed);
+        child.visits.store(0, std::memory_order_relaxed);
+        child.virtual_loss.store(0, std::memory_order_relaxed);
+        child.first_child = MCTS_NO_CHILD;
+        child.num_children = 0;
+        child.move = move_list[i];
+        child.prior = weights[i] / total;
+        child.terminal_value = 0;
+        child.state.store(MCTS_UNEXPANDED, std::memory_order_relaxed);
+    }
+    node.first_child = first;
+    node.num_children = (uint16_t) legal;
+    node.state.store(MCTS_EXPANDED, std::memory_order_release);
+    return true;
+}
+
+bool MCTS_Search::select(Bitboard_Gen & board, leaf & found){
+    uint32_t index = 0;
+    found.length = 0;
+    while(true){
+        mcts_node & node = pool[index];
+        node.virtual_loss.fetch_add(1, std::memory_order_relaxed);
+        found.path[found.length++] = index;
+        uint8_t state = node.state.load(std::memory_order_acquire);
+        if(state == MCTS_TERMINAL)
+            return true;
+        if(state == MCTS_UNEXPANDED){
+            //whoever claims the node expands it, the others count a collision
+            if(!node.state.compare_exchange_strong(state, MCTS_EXPANDING, std::memory_order_acquire))
+                return false;
+            if(!expand(board, index))
+                pool_full.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        if(state == MCTS_EXPANDING)
+            return false;
+
+        //puct, with pending visits of other threads counted as losses
+        float parent_visits = (float) (node.visits.load(std::memory_order_relaxed) + node.virtual_loss.load(std::memory_order_relaxed));
+        float exploration = limits.exploration * std::sqrt(parent_visits);
+        uint32_t best = node.first_child;
+        float best_score = -1e9f;
+        for(uint32_t i = node.first_child; i < node.first_child + node.num_children; i++){
+            mcts_node & child = pool[i];
+            uint32_t visits = child.visits.load(std::memory_order_relaxed);
+            uint32_t virtual_loss = child.virtual_loss.load(std::memory_order_relaxed);
+            float q = visits + virtual_loss
+                ? (float) ((child.value_sum.load(std::memory_order_relaxed) / MCTS_VALUE_SCALE - virtual_loss) / (visits + virtual_loss))
+                : 0;
+            float score = q + exploration * child.prior / (1 + visits + virtual_loss);
+            if(score > best_score){
+                best_score = score;
+                best = i;
+            }
+        }
+        board.make_move(pool[best].move);
+        index = best;
+    }
+}
+
+void MCTS_Search::backpropagate(const leaf & found, float value){
+    for(int i = found.length - 1; i >= 0; i--){
+        mcts_node & node = pool[found.path[i]];
+        node.value_sum.fetch_add((int64_t) (value * MCTS_VALUE_SCALE), std::memory_order_relaxed);
+        node.visits.fetch_add(1, std::memory_order_relaxed);
+        node.virtual_loss.fetch_sub(1, std::memory_order_relaxed);
+        value = -value;
+    }
+}
+
+void MCTS_Search::undo_virtual_loss(const leaf & found){
+    for(int i = 0; i < found.length; i++)
+        pool[found.path[i]].virtual_loss.fetch_sub(1, std::memory_order_relaxed);
+}
+
+//takes the board back to the root along the path
+static void unwind(Bitboard_Gen & board, MCTS_Node_Pool & pool, const uint32_t * path, int length){
+    for(int i = length - 1; i > 0; i--)
+        board.unmake_move(pool[path[i]].move);
+}
+
+void MCTS_Search::worker(const Bitboard_Gen & root){
+    int batch_size = std::max(1, std::min(limits.batch_size, 256));
+    std::vector<std::unique_ptr<Bitboard_Gen>> boards;
+    std::vector<Bitboard_Gen *> pending(batch_size);
+    std::vector<leaf> leaves(batch_size);
+    std::vector<float> values(batch_size);
+    for(int i = 0; i < batch_size; i++)
+        boards.emplace_back(new Bitboard_Gen(root));
+
+    while(!stop_flag.load(std::memory_order_relaxed)){
+        //gather leaves until the batch is full or selection runs into another thread
+        int count = 0;
+        U64 finished = 0;
+        while(count < batch_size){
+            Bitboard_Gen & board = *boards[count];
+            leaf & found = leaves[count];
+            if(!select(board, found)){
+                undo_virtual_loss(found);
+                unwind(board, pool, found.path, found.length);
+                break;
+            }
+            mcts_node & node = pool[found.path[found.length - 1]];
+            if(node.state.load(std::memory_order_acquire) == MCTS_TERMINAL){
+                backpropagate(found, node.terminal_value);
+                unwind(board, pool, found.path, found.length);
+                finished++;
+                continue;
+            }
+            pending[count++] = &board;
+        }
+        if(count){
+            evaluator->evaluate(pending.data(), count, values.data());
+            for(int i = 0; i < count; i++){
+                //the evaluation is for the side to move, the node keeps the mover's view
+                backpropagate(leaves[i], -values[i]);
+                unwind(*boards[i], pool, leaves[i].path, leaves[i].length);
+            }
+        }else if(!finished){
+            std::this_thread::yield();
+        }
+
+        U64 total = playouts.fetch_add(count + finished, std::memory_order_relaxed) + count + finished;
+        if(limits.playouts && total >= limits.playouts)
+            stop_flag.store(true, std::memory_order_relaxed);
+        if(limits.movetime && std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start_time).count() >= limits.movetime)
+            stop_flag.store(true, std::memory_order_relaxed);
+    }
+}
+
+mcts_result MCTS_Search::search(const Bitboard_Gen & root, const mcts_limits & search_limits){
+    limits = search_limits;
+    start_time = std::chrono::steady_clock::now();
+    playouts.store(0);
+    stop_flag.store(false);
+    pool_full.store(false);
+    pool.reset();
+
+    mcts_result result;
+    Bitboard_Gen board(root);
+    uint32_t root_index = pool.allocate(1);
+    mcts_node & root_node = pool[root_index];
+    root_node.value_sum.store(0);
+    root_node.visits.store(0);
+    root_node.virtual_loss.store(0);
+    root_node.state.store(MCTS_UNEXPANDED);
+    expand(board, root_index);
+    if(root_node.state.load() != MCTS_EXPANDED)
+        return result;
+
+    std::vector<std::thread> helpers;
+    for(int i = 1; i < limits.threads; i++)
+        helpers.emplace_back(&MCTS_Search::worker, this, std::cref(root));
+    worker(root);
+    for(auto & helper : helpers)
+        helper.join();
+
+    result.playouts = playouts.load();
+    result.time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+    result.nodes = pool.used();
+    result.pool_full = pool_full.load();
+    for(uint32_t i = root_node.first_child; i < root_node.first_child + root_node.num_children; i++){
+        mcts_node & child = pool[i];
+        uint32_t visits = child.visits.load();
+        result.root_children.push_back({child.move, visits, visits ? (float) (child.value_sum.load() / MCTS_VALUE_SCALE / visits) : 0});
+    }
+    std::stable_sort(result.root_children.begin(), result.root_children.end(),
+                     [](const mcts_child_info & a, const mcts_child_info & b){ return a.visits > b.visits; });
+    result.best_move = result.root_children[0].move;
+
+    //principal variation along the most visited children
+    for(uint32_t index = root_index; pool[index].state.load() == MCTS_EXPANDED && result.pv.size() < 64;){
+        mcts_node & node = pool[index];
+        uint32_t best = node.first_child;
+        for(uint32_t i = node.first_child; i < node.first_child + node.num_children; i++){
+            if(pool[i].visits.load() > pool[best].visits.load())
+                best = i;
+        }
+        if(!pool[best].visits.load())
+            break;
+        result.pv.push_back(pool[best].move);
+        index = best;
+    }
+    return result;
+}
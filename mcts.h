@@ -0,0 +1,126 @@
+//
+//  mcts.h
+//  InvincibleSummer
+//
+//  Monte Carlo tree search for analysis. Nodes come from a fixed size arena and
+//  a node's children sit next to each other in it, so nothing is allocated while
+//  searching. Threads select with PUCT under virtual loss, expand leaves with
+//  generate_moves and the legality check, and gather up to batch_size leaves
+//  before handing them to the evaluator in one call.
+//
+#include "bitboard_gen.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#ifndef MCTS
+#define MCTS
+
+#define MCTS_UNEXPANDED 0
+#define MCTS_EXPANDING 1
+#define MCTS_EXPANDED 2
+#define MCTS_TERMINAL 3
+
+#define MCTS_NO_CHILD 0xffffffffu
+//node values are kept as fixed point so they can be added atomically
+#define MCTS_VALUE_SCALE 65536.0
+
+//values are in [-1, 1] from the point of view of the player who made the move into the node
+struct mcts_node{
+    std::atomic<int64_t> value_sum{0};
+    std::atomic<uint32_t> visits{0};
+    std::atomic<uint32_t> virtual_loss{0};
+    uint32_t first_child = MCTS_NO_CHILD;
+    uint16_t num_children = 0;
+    uint16_t move = 0;
+    float prior = 0;
+    std::atomic<uint8_t> state{MCTS_UNEXPANDED};
+    int8_t terminal_value = 0;
+};
+
+//bump allocator over one block, reset between searches
+class MCTS_Node_Pool{
+public:
+    explicit MCTS_Node_Pool(size_t megabytes);
+    //index of count consecutive nodes, MCTS_NO_CHILD when the pool is full
+    uint32_t allocate(uint32_t count);
+    void reset();
+    mcts_node & operator[](uint32_t index){ return nodes[index]; }
+    size_t used() const { return std::min<size_t>(next.load(), capacity); }
+    size_t size() const { return capacity; }
+
+private:
+    std::unique_ptr<mcts_node[]> nodes;
+    size_t capacity;
+    std::atomic<size_t> next{0};
+};
+
+//scores a batch of positions, values in [-1, 1] for the side to move
+class MCTS_Evaluator{
+public:
+    virtual ~MCTS_Evaluator(){}
+    virtual void evaluate(Bitboard_Gen * const * boards, int count, float * values) = 0;
+};
+
+//the hand written evaluation squashed to [-1, 1]
+class MCTS_Static_Evaluator : public MCTS_Evaluator{
+public:
+    void evaluate(Bitboard_Gen * const * boards, int count, float * values) override;
+};
+
+struct mcts_limits{
+    U64 playouts = 100000;  //0 for no limit
+    int64_t movetime = 0;  //milliseconds, 0 for no limit
+    int threads = 1;
+    int batch_size = 16;
+    float exploration = 1.5f;
+};
+
+struct mcts_child_info{
+    uint16_t move;
+    uint32_t visits;
+    float value;  //for the side to move at the root
+};
+
+struct mcts_result{
+    uint16_t best_move = 0;
+    U64 playouts = 0;
+    int64_t time = 0;  //milliseconds
+    size_t nodes = 0;
+    size_t bytes_per_node = sizeof(mcts_node);
+    bool pool_full = false;
+    std::vector<mcts_child_info> root_children;  //most visited first
+    std::vector<uint16_t> pv;
+};
+
+class MCTS_Search{
+public:
+    MCTS_Search(size_t megabytes, MCTS_Evaluator * evaluator = nullptr);
+    void set_evaluator(MCTS_Evaluator * evaluator);
+    mcts_result search(const Bitboard_Gen & root, const mcts_limits & limits);
+
+private:
+    MCTS_Node_Pool pool;
+    MCTS_Static_Evaluator static_evaluator;
+    MCTS_Evaluator * evaluator;
+    mcts_limits limits;
+    std::chrono::steady_clock::time_point start_time;
+    std::atomic<U64> playouts{0};
+    std::atomic<bool> stop_flag{false};
+    std::atomic<bool> pool_full{false};
+
+    struct leaf{
+        uint32_t path[400];
+        int length;
+    };
+    void worker(const Bitboard_Gen & root);
+    //true when a leaf was reached, false on a collision with another thread
+    bool select(Bitboard_Gen & board, leaf & found);
+    //generates the node's children, returns false if the node could not be expanded
+    bool expand(Bitboard_Gen & board, uint32_t index);
+    void backpropagate(const leaf & found, float value);
+    void undo_virtual_loss(const leaf & found);
+};
+
+#endif
@@ -0,0 +1,39 @@
+//
+//  move_order.cpp
+//  InvincibleSummer
+//
+
+#include "move_order.h"
+#include <algorithm>
+#include <cstring>
+
+void Move_Ordering::clear(){
+    memset(history, 0, sizeof(history));
+    memset(continuation, 0, sizeof(continuation));
+    memset(countermoves, 0, sizeof(countermoves));
+    clear_killers();
+}
+
+void Move_Ordering::clear_killers(){
+    memset(killers, 0, sizeof(killers));
+}
+
+void Move_Ordering::update_quiets(Bitboard_Gen & board, uint16_t best, const uint16_t * tried, int num_tried,
+                                  int prev_piece, int prev_dest, int ply, int depth){
+    int bonus = std::min(32 * depth * depth, 1600);
+    for(int i = 0; i < num_tried; i++){
+        uint16_t move = tried[i];
+        int piece = board.mailbox[(move >> 10) & 0x3f];
+        int dest = (move >> 4) & 0x3f;
+        int signed_bonus = move == best ? bonus : -bonus;
+        gravity(history[piece][dest], signed_bonus);
+        if(prev_piece)
+            gravity(continuation[prev_piece][prev_dest][piece][dest], signed_bonus);
+    }
+    if(ply < ORDER_MAX_PLY && killers[ply][0] != best){
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = best;
+    }
+    if(prev_piece)
+        countermoves[prev_piece][prev_dest] = best;
+}
@@ -0,0 +1,50 @@
+//
+//  move_order.h
+//  InvincibleSummer
+//
+//  Quiet move ordering for the search: history and continuation history indexed
+//  by mailbox piece code and destination square, two killers per ply and a
+//  countermove per previous piece and destination. History entries use gravity
+//  updates, so they stay within +-HISTORY_MAX and old results fade out.
+//
+#include "bitboard_gen.h"
+#include <cstdlib>
+
+#ifndef MOVE_ORDER
+#define MOVE_ORDER
+
+#define HISTORY_MAX 16384
+#define ORDER_MAX_PLY 128
+
+class Move_Ordering{
+public:
+    int16_t history[16][64];
+    //[previous piece][previous destination][piece][destination]
+    int16_t continuation[16][64][16][64];
+    uint16_t killers[ORDER_MAX_PLY][2];
+    uint16_t countermoves[16][64];
+
+    Move_Ordering(){ clear(); }
+    void clear();
+    //killers only mean something within one search, history carries over
+    void clear_killers();
+
+    //history plus continuation history, prev_piece 0 when there is no previous move
+    inline int quiet_score(int piece, int dest, int prev_piece, int prev_dest) const{
+        int score = history[piece][dest];
+        if(prev_piece)
+            score += continuation[prev_piece][prev_dest][piece][dest];
+        return score;
+    }
+
+    //the quiet move that caused a cutoff gets a bonus, the quiets tried before it a malus
+    void update_quiets(Bitboard_Gen & board, uint16_t best, const uint16_t * tried, int num_tried,
+                       int prev_piece, int prev_dest, int ply, int depth);
+
+private:
+    static inline void gravity(int16_t & entry, int bonus){
+        entry += bonus - entry * std::abs(bonus) / HISTORY_MAX;
+    }
+};
+
+#endif
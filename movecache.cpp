@@ -0,0 +1,127 @@
+//
+//  movecache.cpp
+//  InvincibleSummer
+//
+
+#include "movecache.h"
+#include <cstring>
+
+Move_Cache::Move_Cache(size_t megabytes){
+    size_t set_bytes = sizeof(cache_set) + MOVE_CACHE_WAYS * sizeof(cache_entry);
+    size_t num_sets = 1;
+    while(num_sets * 2 * set_bytes <= megabytes * 1024 * 1024)
+        num_sets *= 2;
+    sets.reset(new cache_set[num_sets]);
+    entries.reset(new cache_entry[num_sets * MOVE_CACHE_WAYS]);
+    set_mask = num_sets - 1;
+    clear();
+}
+
+bool Move_Cache::same_position(const cache_entry & entry, const Bitboard_Gen & board){
+    const game_state & state = board.game_history[board.ply];
+    return entry.side == board.current_side && entry.castling_rights == state.castling_rights
+        && entry.ep_target == state.ep_target && !std::memcmp(entry.bitboards, board.bitboards, sizeof(entry.bitboards));
+}
+
+bool Move_Cache::probe(const Bitboard_Gen & board, uint16_t * move_list, int & num_moves, bool & in_check){
+    size_t index = board.zobrist_hash & set_mask;
+    std::lock_guard<std::mutex> guard(locks[index % MOVE_CACHE_LOCKS]);
+    cache_set & set = sets[index];
+    for(int way = 0; way < MOVE_CACHE_WAYS; way++){
+        if(!(set.used >> way & 1) || set.keys[way] != board.zobrist_hash)
+            continue;
+        const cache_entry & entry = entries[index * MOVE_CACHE_WAYS + way];
+        if(!same_position(entry, board))
+            continue;
+        num_moves = entry.num_moves;
+        in_check = entry.in_check;
+        std::memcpy(move_list, entry.moves, num_moves * sizeof(uint16_t));
+        set.referenced |= 1 << way;
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Move_Cache::store(const Bitboard_Gen & board, const uint16_t * move_list, int num_moves, bool in_check){
+    if(num_moves > MOVE_CACHE_MAX_MOVES){
+        skipped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    size_t index = board.zobrist_hash & set_mask;
+    std::lock_guard<std::mutex> guard(locks[index % MOVE_CACHE_LOCKS]);
+    cache_set & set = sets[index];
+    //a free way or the same position stored by another thread, then the clock
+    int way = -1;
+    for(int i = 0; i < MOVE_CACHE_WAYS && way < 0; i++){
+        if(!(set.used >> i & 1) || (set.keys[i] == board.zobrist_hash && same_position(entries[index * MOVE_CACHE_WAYS + i], board)))
+            way = i;
+    }
+    if(way < 0){
+        while(set.referenced >> set.hand & 1){
+            set.referenced &= ~(1 << set.hand);
+            set.hand = (set.hand + 1) % MOVE_CACHE_WAYS;
+        }
+        way = set.hand;
+        set.hand = (set.hand + 1) % MOVE_CACHE_WAYS;
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const game_state & state = board.game_history[board.ply];
+    cache_entry & entry = entries[index * MOVE_CACHE_WAYS + way];
+    std::memcpy(entry.bitboards, board.bitboards, sizeof(entry.bitboards));
+    entry.side = (uint8_t) board.current_side;
+    entry.castling_rights = state.castling_rights;
+    entry.ep_target = (int8_t) state.ep_target;
+    entry.num_moves = (uint8_t) num_moves;
+    entry.in_check = in_check;
+    std::memcpy(entry.moves, move_list, num_moves * sizeof(uint16_t));
+    set.keys[way] = board.zobrist_hash;
+    set.used |= 1 << way;
+    set.referenced &= ~(1 << way);
+}
+
+int Move_Cache::legal_moves(Bitboard_Gen & board, uint16_t * move_list, bool & in_check){
+    int num_moves = 0;
+    if(probe(board, move_list, num_moves, in_check))
+        return num_moves;
+    int generated = board.generate_moves(move_list);
+    for(int i = 0; i < generated; i++){
+        board.make_move(move_list[i]);
+        if(!board.is_move_legal())
+            move_list[num_moves++] = move_list[i];
+        board.unmake_move(move_list[i]);
+    }
+    in_check = board.position_in_check();
+    store(board, move_list, num_moves, in_check);
+    return num_moves;
+}
+
+void Move_Cache::clear(){
+    for(size_t i = 0; i <= set_mask; i++){
+        std::lock_guard<std::mutex> guard(locks[i % MOVE_CACHE_LOCKS]);
+        sets[i].used = 0;
+        sets[i].referenced = 0;
+        sets[i].hand = 0;
+    }
+    hits.store(0);
+    misses.store(0);
+    evictions.store(0);
+    skipped.store(0);
+}
+
+move_cache_stats Move_Cache::stats() const{
+    move_cache_stats current;
+    current.hits = hits.load(std::memory_order_relaxed);
+    current.misses = misses.load(std::memory_order_relaxed);
+    current.evictions = evictions.load(std::memory_order_relaxed);
+    current.skipped = skipped.load(std::memory_order_relaxed);
+    current.capacity = (set_mask + 1) * MOVE_CACHE_WAYS;
+    for(size_t i = 0; i <= set_mask; i++){
+        std::lock_guard<std::mutex> guard(locks[i % MOVE_CACHE_LOCKS]);
+        for(int way = 0; way < MOVE_CACHE_WAYS; way++)
+            current.entries += sets[i].used >> way & 1;
+    }
+    return current;
+}
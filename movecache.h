@@ -0,0 +1,82 @@
+//
+//  movecache.h
+//  InvincibleSummer
+//
+//  Bounded cache of legal move lists for front ends that ask about the same
+//  positions over and over, stepping back and forth through a game or sending
+//  the same fen again. Entries are found by zobrist_hash and then checked
+//  against the bitboards, side, castling rights and en passant square, so a
+//  key collision is a miss and never a wrong list. Positions live in sets of
+//  MOVE_CACHE_WAYS entries, each set evicting with its own CLOCK hand: a hit
+//  marks the entry, and the hand passes over marked entries once, clearing
+//  them, before it replaces one. Safe to share between threads.
+//
+#include "bitboard_gen.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#ifndef MOVE_CACHE
+#define MOVE_CACHE
+
+#define MOVE_CACHE_WAYS 4
+//longer lists are not kept, real games almost never have more legal moves
+#define MOVE_CACHE_MAX_MOVES 64
+#define MOVE_CACHE_LOCKS 64
+
+struct move_cache_stats{
+    U64 hits = 0;
+    U64 misses = 0;
+    U64 evictions = 0;
+    //positions with more than MOVE_CACHE_MAX_MOVES legal moves
+    U64 skipped = 0;
+    size_t entries = 0;
+    size_t capacity = 0;
+    double hit_rate() const { return hits + misses ? (double) hits / (hits + misses) : 0; }
+};
+
+class Move_Cache{
+public:
+    //as many sets as fit in megabytes, a power of two
+    explicit Move_Cache(size_t megabytes);
+
+    //the legal moves of board into move_list, which has room for 256, and
+    //whether the side to move is in check. generates and stores them on a miss
+    int legal_moves(Bitboard_Gen & board, uint16_t * move_list, bool & in_check);
+    bool probe(const Bitboard_Gen & board, uint16_t * move_list, int & num_moves, bool & in_check);
+    void store(const Bitboard_Gen & board, const uint16_t * move_list, int num_moves, bool in_check);
+
+    void clear();
+    move_cache_stats stats() const;
+    size_t memory() const { return (set_mask + 1) * (sizeof(cache_set) + MOVE_CACHE_WAYS * sizeof(cache_entry)); }
+
+private:
+    struct alignas(64) cache_entry{
+        U64 bitboards[8];
+        uint8_t side;
+        uint8_t castling_rights;
+        int8_t ep_target;
+        uint8_t num_moves;
+        bool in_check;
+        uint16_t moves[MOVE_CACHE_MAX_MOVES];
+    };
+    struct alignas(64) cache_set{
+        U64 keys[MOVE_CACHE_WAYS];
+        uint8_t used;        //bit per way
+        uint8_t referenced;  //bit per way, set on a hit
+        uint8_t hand;
+    };
+
+    std::unique_ptr<cache_set[]> sets;
+    std::unique_ptr<cache_entry[]> entries;
+    size_t set_mask;
+    mutable std::mutex locks[MOVE_CACHE_LOCKS];
+    std::atomic<U64> hits{0};
+    std::atomic<U64> misses{0};
+    std::atomic<U64> evictions{0};
+    std::atomic<U64> skipped{0};
+
+    static bool same_position(const cache_entry & entry, const Bitboard_Gen & board);
+};
+
+#endif
@@ -0,0 +1,209 @@
+//
+//  nnue.cpp
+//  InvincibleSummer
+//
+
+#include "bitboard_gen.h"
+#include "nnue.h"
+#include <fstream>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+//out = in + sum of added feature columns - sum of removed feature columns
+static void update_features(const int16_t * in, int16_t * out, const int16_t * weights,
+                            const int * added, int num_added, const int * removed, int num_removed){
+#if defined(__AVX2__)
+    for(int chunk = 0; chunk < NNUE_L1; chunk += 16){
+        __m256i acc = _mm256_loadu_si256((const __m256i *) (in + chunk));
+        for(int i = 0; i < num_added; i++)
+            acc = _mm256_add_epi16(acc, _mm256_loadu_si256((const __m256i *) (weights + added[i] * NNUE_L1 + chunk)));
+        for(int i = 0; i < num_removed; i++)
+            acc = _mm256_sub_epi16(acc, _mm256_loadu_si256((const __m256i *) (weights + removed[i] * NNUE_L1 + chunk)));
+        _mm256_storeu_si256((__m256i *) (out + chunk), acc);
+    }
+#else
+    for(int j = 0; j < NNUE_L1; j++){
+        int16_t value = in[j];
+        for(int i = 0; i < num_added; i++)
+            value += weights[added[i] * NNUE_L1 + j];
+        for(int i = 0; i < num_removed; i++)
+            value -= weights[removed[i] * NNUE_L1 + j];
+        out[j] = value;
+    }
+#endif
+}
+
+static inline uint8_t clipped_relu(int32_t x){
+    return (uint8_t) (x < 0 ? 0 : (x > 127 ? 127 : x));
+}
+
+NNUE_Network::NNUE_Network() :
+    ft_biases(NNUE_L1, 0), ft_weights((size_t) NNUE_INPUTS * NNUE_L1, 0){
+    for(int i = 0; i < NNUE_L2; i++){
+        l1_biases[i] = 0;
+        for(int j = 0; j < 2 * NNUE_L1; j++)
+            l1_weights[i][j] = 0;
+    }
+    for(int i = 0; i < NNUE_L3; i++){
+        l2_biases[i] = 0;
+        out_weights[i] = 0;
+        for(int j = 0; j < NNUE_L2; j++)
+            l2_weights[i][j] = 0;
+    }
+    out_bias = 0;
+}
+
+template<typename T>
+static bool read_array(std::ifstream & file, T * data, size_t count){
+    file.read((char *) data, sizeof(T) * count);
+    return (bool) file;
+}
+
+bool NNUE_Network::load(const std::string & path){
+    loaded = false;
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+        return false;
+    uint32_t header[3];
+    if(!read_array(file, header, 3) || header[0] != NNUE_FILE_MAGIC
+       || header[1] != NNUE_FILE_VERSION || header[2] != NNUE_L1)
+        return false;
+    if(!read_array(file, ft_biases.data(), ft_biases.size())
+       || !read_array(file, ft_weights.data(), ft_weights.size())
+       || !read_array(file, l1_biases, NNUE_L2)
+       || !read_array(file, &l1_weights[0][0], NNUE_L2 * 2 * NNUE_L1)
+       || !read_array(file, l2_biases, NNUE_L3)
+       || !read_array(file, &l2_weights[0][0], NNUE_L3 * NNUE_L2)
+       || !read_array(file, &out_bias, 1)
+       || !read_array(file, out_weights, NNUE_L3))
+        return false;
+    loaded = true;
+    return true;
+}
+
+NNUE_Accumulator::NNUE_Accumulator(const NNUE_Network * net) : network(net){
+    reset();
+}
+
+void NNUE_Accumulator::reset(){
+    top = 0;
+    recording = false;
+    stack[0].computed[WHITE] = stack[0].computed[BLACK] = false;
+    stack[0].num_dirty = 0;
+}
+
+void NNUE_Accumulator::push(){
+    assert(top + 1 < NNUE_STACK_SIZE);
+    top++;
+    stack[top].computed[WHITE] = stack[top].computed[BLACK] = false;
+    stack[top].num_dirty = 0;
+    recording = true;
+}
+
+//the previous entry is untouched by make_move, so unmaking is just moving the top back
+void NNUE_Accumulator::pop(){
+    top--;
+    recording = false;
+}
+
+int NNUE_Accumulator::feature_index(int perspective, int king_square, int piece, int square){
+    //black sees the board upside down so both sides share the same weights
+    if(perspective == BLACK){
+        king_square ^= 56;
+        square ^= 56;
+    }
+    int piece_index = ((piece >> 1) - PAWN_BOARD) * 2 + ((piece & 1) != perspective);
+    return king_square * NNUE_PIECE_FEATURES + piece_index * 64 + square;
+}
+
+//finds the nearest computed ancestor and replays the deltas forward, a move of
+//the perspective's own king changes every feature so that needs a full refresh
+void NNUE_Accumulator::update_perspective(Bitboard_Gen & board, int perspective){
+    if(stack[top].computed[perspective])
+        return;
+    int own_king = perspective + (KING_BOARD << 1);
+    int i = top;
+    while(!stack[i].computed[perspective]){
+        if(i == 0){
+            refresh(board, stack[top], perspective);
+            return;
+        }
+        for(int d = 0; d < stack[i].num_dirty; d++){
+            if(stack[i].dirty[d].piece == own_king){
+                refresh(board, stack[top], perspective);
+                return;
+            }
+        }
+        i--;
+    }
+    int king_square = board.get_square_index(board.bitboards[perspective] & board.bitboards[KING_BOARD]);
+    for(int j = i + 1; j <= top; j++)
+        apply_dirty(stack[j - 1], stack[j], perspective, king_square);
+}
+
+void NNUE_Accumulator::refresh(Bitboard_Gen & board, nnue_accumulator_entry & entry, int perspective){
+    int king_square = board.get_square_index(board.bitboards[perspective] & board.bitboards[KING_BOARD]);
+    int active[32];
+    int num_active = 0;
+    U64 pieces = (board.bitboards[WHITE] | board.bitboards[BLACK]) & ~board.bitboards[KING_BOARD];
+    while(pieces){
+        int square = board.pop_lsb(&pieces);
+        active[num_active++] = feature_index(perspective, king_square, board.mailbox[square], square);
+    }
+    update_features(network->ft_biases.data(), entry.values[perspective], network->ft_weights.data(),
+                    active, num_active, nullptr, 0);
+    entry.computed[perspective] = true;
+}
+
+void NNUE_Accumulator::apply_dirty(const nnue_accumulator_entry & prev, nnue_accumulator_entry & entry,
+                                   int perspective, int king_square){
+    int added[NNUE_MAX_DIRTY], removed[NNUE_MAX_DIRTY];
+    int num_added = 0, num_removed = 0;
+    for(int d = 0; d < entry.num_dirty; d++){
+        const nnue_dirty_piece & dirty = entry.dirty[d];
+        //kings are not features
+        if((dirty.piece >> 1) == KING_BOARD)
+            continue;
+        if(dirty.from >= 0)
+            removed[num_removed++] = feature_index(perspective, king_square, dirty.piece, dirty.from);
+        if(dirty.to >= 0)
+            added[num_added++] = feature_index(perspective, king_square, dirty.piece, dirty.to);
+    }
+    update_features(prev.values[perspective], entry.values[perspective], network->ft_weights.data(),
+                    added, num_added, removed, num_removed);
+    entry.computed[perspective] = true;
+}
+
+int NNUE_Accumulator::evaluate(Bitboard_Gen & board){
+    update_perspective(board, WHITE);
+    update_perspective(board, BLACK);
+    const nnue_accumulator_entry & entry = stack[top];
+
+    //side to move first, then the opponent
+    uint8_t input[2 * NNUE_L1];
+    for(int i = 0; i < NNUE_L1; i++){
+        input[i] = clipped_relu(entry.values[board.current_side][i]);
+        input[NNUE_L1 + i] = clipped_relu(entry.values[!board.current_side][i]);
+    }
+
+    uint8_t hidden1[NNUE_L2];
+    for(int o = 0; o < NNUE_L2; o++){
+        int32_t sum = network->l1_biases[o];
+        for(int i = 0; i < 2 * NNUE_L1; i++)
+            sum += network->l1_weights[o][i] * input[i];
+        hidden1[o] = clipped_relu(sum >> NNUE_WEIGHT_SHIFT);
+    }
+    uint8_t hidden2[NNUE_L3];
+    for(int o = 0; o < NNUE_L3; o++){
+        int32_t sum = network->l2_biases[o];
+        for(int i = 0; i < NNUE_L2; i++)
+            sum += network->l2_weights[o][i] * hidden1[i];
+        hidden2[o] = clipped_relu(sum >> NNUE_WEIGHT_SHIFT);
+    }
+    int32_t output = network->out_bias;
+    for(int i = 0; i < NNUE_L3; i++)
+        output += network->out_weights[i] * hidden2[i];
+    return output / NNUE_OUTPUT_SCALE;
+}
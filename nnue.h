@@ -0,0 +1,100 @@
+//
+//  nnue.h
+//  InvincibleSummer
+//
+//  Efficiently updatable network evaluation. The accumulator is kept in sync
+//  with the board through the add_piece/remove_piece/move_piece hooks, deltas
+//  are only recorded during make_move and applied when an evaluation is asked for.
+//
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef NNUE_EVAL
+#define NNUE_EVAL
+
+class Bitboard_Gen;
+
+//HalfKP style features: own king square x (5 piece types x 2 colors) x 64 squares
+#define NNUE_PIECE_FEATURES 640
+#define NNUE_INPUTS (64 * NNUE_PIECE_FEATURES)
+#define NNUE_L1 256
+#define NNUE_L2 32
+#define NNUE_L3 32
+#define NNUE_WEIGHT_SHIFT 6
+#define NNUE_OUTPUT_SCALE 16
+
+//"NNUE" read as a little endian uint32
+#define NNUE_FILE_MAGIC 0x45554e4e
+#define NNUE_FILE_VERSION 1
+
+//at most 3 piece changes per move (promotion capture), 4 to be safe
+#define NNUE_MAX_DIRTY 4
+#define NNUE_STACK_SIZE 400
+
+struct nnue_dirty_piece{
+    int piece;  //mailbox piece code
+    int from;   //-1 if the piece was added
+    int to;     //-1 if the piece was removed
+};
+
+struct nnue_accumulator_entry{
+    alignas(32) int16_t values[2][NNUE_L1];
+    bool computed[2];
+    int num_dirty;
+    nnue_dirty_piece dirty[NNUE_MAX_DIRTY];
+};
+
+//network weights, shared read only between all accumulators and threads
+class NNUE_Network{
+public:
+    std::vector<int16_t> ft_biases;
+    std::vector<int16_t> ft_weights; //[NNUE_INPUTS][NNUE_L1]
+    int32_t l1_biases[NNUE_L2];
+    int8_t l1_weights[NNUE_L2][2 * NNUE_L1];
+    int32_t l2_biases[NNUE_L3];
+    int8_t l2_weights[NNUE_L3][NNUE_L2];
+    int32_t out_bias;
+    int8_t out_weights[NNUE_L3];
+    bool loaded = false;
+
+    NNUE_Network();
+    //file layout (little endian): magic, version, L1 size, then every array above in order
+    bool load(const std::string & path);
+};
+
+//per board accumulator stack, one entry per ply from the root of set_board
+class NNUE_Accumulator{
+public:
+    NNUE_Accumulator(const NNUE_Network * net);
+
+    //called from set_board, make_move/unmake_move and the null move pair
+    void reset();
+    void push();
+    void pop();
+    //piece change hook, only records while a make_move is in progress
+    inline void record(int piece, int from, int to){
+        if(!recording)
+            return;
+        nnue_accumulator_entry & entry = stack[top];
+        entry.dirty[entry.num_dirty++] = {piece, from, to};
+    }
+
+    //static evaluation in centipawns from the side to move's point of view
+    int evaluate(Bitboard_Gen & board);
+
+    static int feature_index(int perspective, int king_square, int piece, int square);
+
+private:
+    const NNUE_Network * network;
+    nnue_accumulator_entry stack[NNUE_STACK_SIZE];
+    int top = 0;
+    bool recording = false;
+
+    void update_perspective(Bitboard_Gen & board, int perspective);
+    void refresh(Bitboard_Gen & board, nnue_accumulator_entry & entry, int perspective);
+    void apply_dirty(const nnue_accumulator_entry & prev, nnue_accumulator_entry & entry,
+                     int perspective, int king_square);
+};
+
+#endif
@@ -0,0 +1,188 @@
+//
+//  notation.cpp
+//  InvincibleSummer
+//
+
+#include "notation.h"
+#include <cstring>
+
+static const char promo_chars[4] = {'b', 'n', 'r', 'q'};
+//by piece type, pawns have no letter
+static const char piece_letters[8] = {0, 0, 0, 'B', 'N', 'R', 'Q', 'K'};
+//san letters from BISHOP_BOARD up, promotions in flag order in either case
+static const char san_pieces[5] = {'B', 'N', 'R', 'Q', 'K'};
+static const char san_promotions[8] = {'B', 'N', 'R', 'Q', 'b', 'n', 'r', 'q'};
+
+static inline int move_source(uint16_t move){ return (move >> 10) & 0x3f; }
+static inline int move_dest(uint16_t move){ return (move >> 4) & 0x3f; }
+
+static bool legal(Bitboard_Gen & board, uint16_t move){
+    board.make_move(move);
+    bool illegal = board.is_move_legal();
+    board.unmake_move(move);
+    return !illegal;
+}
+
+static inline int text_length(const char * text, int length){
+    return length < 0 ? (int) std::strlen(text) : length;
+}
+
+int to_uci(uint16_t move, char * out){
+    if(!move){
+        std::memcpy(out, "0000", 5);
+        return 4;
+    }
+    int source = move_source(move), dest = move_dest(move);
+    int length = 0;
+    out[length++] = (char) ('a' + (source & 7));
+    out[length++] = (char) ('1' + (source >> 3));
+    out[length++] = (char) ('a' + (dest & 7));
+    out[length++] = (char) ('1' + (dest >> 3));
+    if(move & 8)
+        out[length++] = promo_chars[move & 3];
+    out[length] = 0;
+    return length;
+}
+
+int to_san(Bitboard_Gen & board, uint16_t move, char * out){
+    int source = move_source(move), dest = move_dest(move), flag = move & 0x0f;
+    int type = board.mailbox[source] >> 1;
+    int length = 0;
+    if(flag == KINGSIDE_CASTLE_FLAG || flag == QUEENSIDE_CASTLE_FLAG){
+        const char * castle = flag == KINGSIDE_CASTLE_FLAG ? "O-O" : "O-O-O";
+        length = (int) std::strlen(castle);
+        std::memcpy(out, castle, length);
+    }else{
+        if(type == PAWN_BOARD){
+            if(flag & CAPTURE_FLAG)
+                out[length++] = (char) ('a' + (source & 7));
+        }else{
+            out[length++] = piece_letters[type];
+            //other legal moves of the same kind of piece to the same square
+            uint16_t move_list[256];
+            int num_moves = board.generate_moves(move_list);
+            bool ambiguous = false, same_file = false, same_rank = false;
+            for(int i = 0; i < num_moves; i++){
+                int other = move_source(move_list[i]);
+                if(other == source || move_dest(move_list[i]) != dest || (board.mailbox[other] >> 1) != type
+                   || !legal(board, move_list[i]))
+                    continue;
+                ambiguous = true;
+                same_file |= (other & 7) == (source & 7);
+                same_rank |= (other >> 3) == (source >> 3);
+            }
+            if(ambiguous && (!same_file || same_rank))
+                out[length++] = (char) ('a' + (source & 7));
+            if(ambiguous && same_file)
+                out[length++] = (char) ('1' + (source >> 3));
+        }
+        if(flag & CAPTURE_FLAG)
+            out[length++] = 'x';
+        out[length++] = (char) ('a' + (dest & 7));
+        out[length++] = (char) ('1' + (dest >> 3));
+        if(flag & 8){
+            out[length++] = '=';
+            out[length++] = (char) (promo_chars[flag & 3] - 'a' + 'A');
+        }
+    }
+    board.make_move(move);
+    if(board.position_in_check())
+        out[length++] = board.count_legal_moves() ? '+' : '#';
+    board.unmake_move(move);
+    out[length] = 0;
+    return length;
+}
+
+uint16_t from_uci(Bitboard_Gen & board, const char * text, int length){
+    length = text_length(text, length);
+    if(length < 4 || length > 5 || text[0] < 'a' || text[0] > 'h' || text[1] < '1' || text[1] > '8'
+       || text[2] < 'a' || text[2] > 'h' || text[3] < '1' || text[3] > '8')
+        return 0;
+    int source = (text[1] - '1') * 8 + (text[0] - 'a');
+    int dest = (text[3] - '1') * 8 + (text[2] - 'a');
+    int promo = -1;
+    if(length == 5){
+        const char * found = (const char *) std::memchr(promo_chars, text[4], 4);
+        if(!found)
+            return 0;
+        promo = (int) (found - promo_chars);
+    }
+    uint16_t move_list[256];
+    int num_moves = board.generate_moves(move_list);
+    for(int i = 0; i < num_moves; i++){
+        uint16_t move = move_list[i];
+        if(move_source(move) != source || move_dest(move) != dest || ((move & 8) ? (move & 3) != promo : promo >= 0))
+            continue;
+        return legal(board, move) ? move : 0;
+    }
+    return 0;
+}
+
+uint16_t from_san(Bitboard_Gen & board, const char * text, int length){
+    length = text_length(text, length);
+    while(length && std::memchr("+#!?", text[length - 1], 4))
+        length--;
+    if(length < 2)
+        return 0;
+
+    uint16_t move_list[256];
+    int num_moves = board.generate_moves(move_list);
+    //castling, written with letters or zeros
+    if(text[0] == 'O' || text[0] == '0'){
+        int flag = (length == 3 && (!std::strncmp(text, "O-O", 3) || !std::strncmp(text, "0-0", 3))) ? KINGSIDE_CASTLE_FLAG
+            : (length == 5 && (!std::strncmp(text, "O-O-O", 5) || !std::strncmp(text, "0-0-0", 5))) ? QUEENSIDE_CASTLE_FLAG : -1;
+        for(int i = 0; i < num_moves; i++){
+            if((move_list[i] & 0x0f) == flag)
+                return legal(board, move_list[i]) ? move_list[i] : 0;
+        }
+        return 0;
+    }
+
+    int type = PAWN_BOARD, position = 0;
+    const char * letter = (const char *) std::memchr(san_pieces, text[0], 5);
+    if(letter){
+        type = (int) (letter - san_pieces) + BISHOP_BOARD;
+        position++;
+    }
+    //promotion at the end, with or without =
+    int promo = -1;
+    if(type == PAWN_BOARD && length >= 3){
+        char last = text[length - 1];
+        const char * found = (const char *) std::memchr(san_promotions, last, 8);
+        if(found){
+            promo = (int) (found - san_promotions) & 3;
+            length -= text[length - 2] == '=' ? 2 : 1;
+        }
+    }
+    if(length - position < 2)
+        return 0;
+    char dest_file = text[length - 2], dest_rank = text[length - 1];
+    if(dest_file < 'a' || dest_file > 'h' || dest_rank < '1' || dest_rank > '8')
+        return 0;
+    int dest = (dest_rank - '1') * 8 + (dest_file - 'a');
+    //what is left between the piece and the destination: disambiguation and x
+    int from_file = -1, from_rank = -1;
+    for(int i = position; i < length - 2; i++){
+        if(text[i] >= 'a' && text[i] <= 'h') from_file = text[i] - 'a';
+        else if(text[i] >= '1' && text[i] <= '8') from_rank = text[i] - '1';
+        else if(text[i] != 'x' && text[i] != ':') return 0;
+    }
+
+    uint16_t found = 0;
+    for(int i = 0; i < num_moves; i++){
+        uint16_t move = move_list[i];
+        int source = move_source(move), flag = move & 0x0f;
+        if(move_dest(move) != dest || (board.mailbox[source] >> 1) != type || flag == KINGSIDE_CASTLE_FLAG || flag == QUEENSIDE_CASTLE_FLAG)
+            continue;
+        if((from_file >= 0 && (source & 7) != from_file) || (from_rank >= 0 && (source >> 3) != from_rank))
+            continue;
+        if((flag & 8) ? (flag & 3) != promo : promo >= 0)
+            continue;
+        if(!legal(board, move))
+            continue;
+        if(found)
+            return 0;
+        found = move;
+    }
+    return found;
+}
@@ -0,0 +1,28 @@
+//
+//  notation.h
+//  InvincibleSummer
+//
+//  Move text in UCI (e2e4, e7e8q) and SAN (Nbd7, exd8=Q+, O-O-O#) without heap
+//  allocation. Writers fill a caller's buffer of at least MOVE_TEXT_SIZE chars,
+//  nul terminated, and return the length. Readers take the text up to its nul or
+//  the length given and return the legal move it names, 0 if there is none.
+//  Functions taking a board leave it as they found it.
+//
+#include "bitboard_gen.h"
+
+#ifndef NOTATION
+#define NOTATION
+
+//longest is a disambiguated capture with check, Qa1xb2+, and the nul
+#define MOVE_TEXT_SIZE 8
+
+int to_uci(uint16_t move, char * out);
+//the board is the position the move is played from
+int to_san(Bitboard_Gen & board, uint16_t move, char * out);
+
+uint16_t from_uci(Bitboard_Gen & board, const char * text, int length = -1);
+//accepts 0-0 for O-O, a missing or lowercase promotion =, and any +, #, ! or ?
+//suffix, but not an ambiguous move
+uint16_t from_san(Bitboard_Gen & board, const char * text, int length = -1);
+
+#endif
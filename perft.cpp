@@ -0,0 +1,314 @@
+//
+//  perft.cpp
+//  InvincibleSummer
+//
+
+#include "perft.h"
+#include "notation.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+//subtrees this shallow run without looking at the stop flag, well under a millisecond
+#define PERFT_STOP_DEPTH 3
+
+static std::string move_text(uint16_t move){
+    char text[MOVE_TEXT_SIZE];
+    return std::string(text, to_uci(move, text));
+}
+
+//the legal moves of the position, each board copy makes its own moves
+static std::vector<uint16_t> legal_moves(Bitboard_Gen & board){
+    std::vector<uint16_t> moves;
+    uint16_t move_list[256];
+    int num_moves = board.generate_moves(move_list);
+    for(int i = 0; i < num_moves; i++){
+        board.make_move(move_list[i]);
+        if(!board.is_move_legal())
+            moves.push_back(move_list[i]);
+        board.unmake_move(move_list[i]);
+    }
+    return moves;
+}
+
+static inline bool stopped(const std::atomic<bool> * stop){
+    return stop && stop->load(std::memory_order_relaxed);
+}
+
+//Bitboard_Gen::perft with the stop flag read before every move above PERFT_STOP_DEPTH
+static U64 stoppable_perft(Bitboard_Gen & board, int depth, const std::atomic<bool> * stop){
+    if(!stop || depth <= PERFT_STOP_DEPTH)
+        return board.perft(depth);
+    U64 nodes = 0;
+    uint16_t move_list[256];
+    int num_moves = board.generate_moves(move_list);
+    for(int i = 0; i < num_moves && !stopped(stop); i++){
+        board.make_move(move_list[i]);
+        if(!board.is_move_legal())
+            nodes += stoppable_perft(board, depth - 1, stop);
+        board.unmake_move(move_list[i]);
+    }
+    return nodes;
+}
+
+//threads take root moves one at a time, so one heavy move does not hold up a whole share
+static void for_each_root_move(const Bitboard_Gen & root, const std::vector<uint16_t> & moves, int threads,
+                               const std::atomic<bool> * stop, const std::function<void(Bitboard_Gen &, size_t)> & body){
+    std::atomic<size_t> next{0};
+    auto worker = [&](){
+        Bitboard_Gen board = root;
+        board.nnue = nullptr;
+        for(size_t i = next.fetch_add(1); i < moves.size() && !stopped(stop); i = next.fetch_add(1)){
+            board.make_move(moves[i]);
+            body(board, i);
+            board.unmake_move(moves[i]);
+        }
+    };
+    std::vector<std::thread> pool;
+    for(int i = 1; i < std::min<int>(threads, (int) moves.size()); i++)
+        pool.emplace_back(worker);
+    worker();
+    for(auto & thread : pool)
+        thread.join();
+}
+
+std::vector<divide_entry> perft_divide(const Bitboard_Gen & root, int depth, int threads, const std::atomic<bool> * stop){
+    Bitboard_Gen board = root;
+    board.nnue = nullptr;
+    std::vector<uint16_t> moves = legal_moves(board);
+    std::vector<divide_entry> entries(moves.size());
+    for_each_root_move(root, moves, threads, stop, [&](Bitboard_Gen & child, size_t i){
+        entries[i] = {moves[i], depth > 1 ? stoppable_perft(child, depth - 1, stop) : 1};
+    });
+    return entries;
+}
+
+perft_stats & perft_stats::operator+=(const perft_stats & other){
+    nodes += other.nodes;
+    captures += other.captures;
+    en_passant += other.en_passant;
+    castles += other.castles;
+    promotions += other.promotions;
+    checks += other.checks;
+    discovered_checks += other.discovered_checks;
+    double_checks += other.double_checks;
+    checkmates += other.checkmates;
+    return *this;
+}
+
+//pieces of the side not to move attacking the king of the side to move
+static U64 checkers(Bitboard_Gen & board){
+    int side = board.current_side;
+    int king_source = board.get_square_index(board.bitboards[side] & board.bitboards[KING_BOARD]);
+    U64 enemies = board.bitboards[!side];
+    board.occupied_board = board.bitboards[WHITE] | board.bitboards[BLACK];
+    return enemies & ((board.pawn_capture_lookup[side][king_source] & board.bitboards[PAWN_BOARD])
+                      | (board.knight_move_lookup[king_source] & board.bitboards[KNIGHT_BOARD])
+                      | (board.diagonal_attacks(king_source) & (board.bitboards[BISHOP_BOARD] | board.bitboards[QUEEN_BOARD]))
+                      | (board.orthogonal_attacks(king_source) & (board.bitboards[ROOK_BOARD] | board.bitboards[QUEEN_BOARD])));
+}
+
+//only the last ply is made and classified, gives_check keeps the check work to checking moves
+static void perft_stats_node(Bitboard_Gen & board, int depth, perft_stats & stats, const std::atomic<bool> * stop){
+    uint16_t move_list[256];
+    int num_moves = board.generate_moves(move_list);
+    check_info info;
+    if(depth == 1)
+        board.compute_check_info(info);
+    for(int i = 0; i < num_moves && !(depth > PERFT_STOP_DEPTH && stopped(stop)); i++){
+        uint16_t move = move_list[i];
+        bool check = depth == 1 && board.gives_check(move, info);
+        board.make_move(move);
+        if(!board.is_move_legal()){
+            if(depth > 1){
+                perft_stats_node(board, depth - 1, stats, stop);
+            }else{
+                int flag = move & 0x0f;
+                int dest = (move >> 4) & 0x3f;
+                stats.nodes++;
+                stats.captures += (flag & CAPTURE_FLAG) != 0;
+                stats.en_passant += flag == EN_PASSANT_FLAG;
+                stats.castles += flag == KINGSIDE_CASTLE_FLAG || flag == QUEENSIDE_CASTLE_FLAG;
+                stats.promotions += (flag & 8) != 0;
+                if(check){
+                    U64 attackers = checkers(board);
+                    U64 moved = board.occupy_square[dest];
+                    if(flag == KINGSIDE_CASTLE_FLAG || flag == QUEENSIDE_CASTLE_FLAG)
+                        moved |= board.occupy_square[flag == KINGSIDE_CASTLE_FLAG ? dest - 1 : dest + 1];
+                    stats.checks++;
+                    bool double_check = board.popcount(attackers) > 1;
+                    stats.discovered_checks += !double_check && (attackers & ~moved);
+                    stats.double_checks += double_check;
+                    stats.checkmates += !board.count_legal_moves();
+                }
+            }
+        }
+        board.unmake_move(move);
+    }
+}
+
+perft_stats perft_statistics(const Bitboard_Gen & root, int depth, int threads, const std::atomic<bool> * stop){
+    Bitboard_Gen board = root;
+    board.nnue = nullptr;
+    perft_stats total;
+    depth = std::max(1, depth);
+    if(depth == 1){
+        perft_stats_node(board, 1, total, stop);
+        return total;
+    }
+    std::vector<uint16_t> moves = legal_moves(board);
+    std::vector<perft_stats> per_move(moves.size());
+    for_each_root_move(root, moves, threads, stop, [&](Bitboard_Gen & child, size_t i){
+        //counted locally, neighbouring entries belong to other threads
+        perft_stats local;
+        perft_stats_node(child, depth - 1, local, stop);
+        per_move[i] = local;
+    });
+    for(const perft_stats & stats : per_move)
+        total += stats;
+    return total;
+}
+
+bool load_perft_reference(const std::string & path, std::map<std::string, U64> & reference){
+    std::ifstream file(path);
+    if(!file)
+        return false;
+    std::string line;
+    while(std::getline(file, line)){
+        size_t colon = line.find(':');
+        if(colon == std::string::npos || colon == 0)
+            continue;
+        std::string moves = line.substr(0, colon);
+        //every token before the colon has to look like a move
+        bool valid = true;
+        std::istringstream tokens(moves);
+        std::string token, key;
+        while(tokens >> token){
+            valid &= token.size() >= 4 && token.size() <= 5 && token[0] >= 'a' && token[0] <= 'h' && token[1] >= '1' && token[1] <= '8';
+            key += (key.empty() ? "" : " ") + token;
+        }
+        if(!valid || key.empty())
+            continue;
+        try{
+            reference[key] = std::stoull(line.substr(colon + 1));
+        }catch(...){
+            continue;
+        }
+    }
+    return true;
+}
+
+static U64 perft_tree(Bitboard_Gen & board, int depth, int levels, const std::string & path, std::map<std::string, U64> & counts,
+                      const std::atomic<bool> * stop){
+    if(!levels || !depth)
+        return stoppable_perft(board, depth, stop);
+    U64 total = 0;
+    for(uint16_t move : legal_moves(board)){
+        std::string child_path = path + " " + move_text(move);
+        board.make_move(move);
+        U64 nodes = perft_tree(board, depth - 1, levels - 1, child_path, counts, stop);
+        board.unmake_move(move);
+        counts[child_path] = nodes;
+        total += nodes;
+    }
+    return total;
+}
+
+bool save_perft_reference(const std::string & path, const Bitboard_Gen & root, int depth, int levels, int threads,
+                          const std::atomic<bool> * stop){
+    Bitboard_Gen board = root;
+    board.nnue = nullptr;
+    std::vector<uint16_t> moves = legal_moves(board);
+    std::map<std::string, U64> counts;
+    std::mutex counts_mutex;
+    for_each_root_move(root, moves, threads, stop, [&](Bitboard_Gen & child, size_t i){
+        std::map<std::string, U64> local;
+        std::string move = move_text(moves[i]);
+        U64 nodes = perft_tree(child, depth - 1, levels - 1, move, local, stop);
+        std::lock_guard<std::mutex> lock(counts_mutex);
+        counts.insert(local.begin(), local.end());
+        counts[move] = nodes;
+    });
+    if(stopped(stop))
+        return false;
+    std::ofstream file(path);
+    for(const auto & entry : counts)
+        file << entry.first << ": " << entry.second << '\n';
+    return (bool) file;
+}
+
+std::string perft_diagnose(const Bitboard_Gen & root, int depth, int threads, const std::map<std::string, U64> * reference,
+                           const std::function<void(const std::string &)> & output, const std::atomic<bool> * stop){
+    Bitboard_Gen board = root;
+    board.nnue = nullptr;
+    std::string path;
+    for(; depth > 0; depth--){
+        auto start = std::chrono::steady_clock::now();
+        std::vector<divide_entry> entries = perft_divide(board, depth, threads, stop);
+        if(stopped(stop)){
+            output("info string perft stopped");
+            return "";
+        }
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        std::string prefix = path.empty() ? "" : path + " ";
+
+        U64 total = 0;
+        uint16_t first_mismatch = 0;
+        std::set<std::string> generated;
+        for(const divide_entry & entry : entries){
+            std::string move = move_text(entry.move);
+            std::string line = move + ": " + std::to_string(entry.nodes);
+            generated.insert(move);
+            total += entry.nodes;
+            if(reference){
+                auto found = reference->find(prefix + move);
+                if(found == reference->end())
+                    line += "  extra, not in reference";
+                else if(found->second != entry.nodes)
+                    line += "  expected " + std::to_string(found->second);
+                if((found == reference->end() || found->second != entry.nodes) && !first_mismatch)
+                    first_mismatch = entry.move;
+            }
+            output(line);
+        }
+        output("\nNodes searched: " + std::to_string(total) + " in " + std::to_string(elapsed) + " ms\n");
+        if(!reference)
+            return "";
+
+        //reference moves the generator never produced
+        bool missing = false;
+        for(auto found = reference->lower_bound(prefix); found != reference->end() && found->first.compare(0, prefix.size(), prefix) == 0; found++){
+            std::string move = found->first.substr(prefix.size());
+            if(move.find(' ') == std::string::npos && !generated.count(move)){
+                output(move + ": missing, expected " + std::to_string(found->second));
+                missing = true;
+            }
+        }
+        if(missing){
+            output("info string first mismatch at " + (path.empty() ? std::string("root") : path));
+            return path.empty() ? "root" : path;
+        }
+        if(!first_mismatch){
+            output("info string " + (path.empty() ? std::string("root") : path) + " matches the reference");
+            return "";
+        }
+
+        std::string next = prefix + move_text(first_mismatch);
+        auto deeper = reference->lower_bound(next + " ");
+        bool has_children = deeper != reference->end() && deeper->first.compare(0, next.size() + 1, next + " ") == 0;
+        if(depth == 1 || !has_children){
+            output("info string first mismatch at " + next + (depth > 1 ? ", reference has no deeper counts" : ""));
+            return next;
+        }
+        output("info string descending into " + next);
+        board.make_move(first_mismatch);
+        path = next;
+    }
+    return path;
+}
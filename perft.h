@@ -0,0 +1,65 @@
+//
+//  perft.h
+//  InvincibleSummer
+//
+//  Perft divide diagnostics. Root moves are shared out between threads, and a
+//  reference file lets a broken generator be walked down to the first position
+//  whose move list disagrees. Every function takes an optional stop flag that is
+//  read before each move until a few plies from the leaves, once it is set the
+//  counts are partial.
+//
+#include "bitboard_gen.h"
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef PERFT
+#define PERFT
+
+struct divide_entry{
+    uint16_t move;
+    U64 nodes;
+};
+
+//leaf moves by kind, counted the usual way: a capture that promotes is both,
+//en passant is also a capture, and a discovered check is a single check given
+//by a piece other than the one that moved (the rook counts as moved when
+//castling). double checks are only counted as double
+struct perft_stats{
+    U64 nodes = 0;
+    U64 captures = 0;
+    U64 en_passant = 0;
+    U64 castles = 0;
+    U64 promotions = 0;
+    U64 checks = 0;
+    U64 discovered_checks = 0;
+    U64 double_checks = 0;
+    U64 checkmates = 0;
+
+    perft_stats & operator+=(const perft_stats & other);
+};
+
+//perft with the leaf moves broken down by kind, root moves shared out between threads
+perft_stats perft_statistics(const Bitboard_Gen & root, int depth, int threads, const std::atomic<bool> * stop = nullptr);
+
+//node count below every legal root move, in generation order
+std::vector<divide_entry> perft_divide(const Bitboard_Gen & root, int depth, int threads, const std::atomic<bool> * stop = nullptr);
+
+//reference counts keyed by the uci moves leading to the node, e.g. "e2e4 e7e5".
+//one "<moves>: <count>" per line, so plain divide output from another engine
+//reads as the root entries, anything else on a line is ignored
+bool load_perft_reference(const std::string & path, std::map<std::string, U64> & reference);
+//writes the counts of every node up to levels moves deep, nothing if stopped
+bool save_perft_reference(const std::string & path, const Bitboard_Gen & root, int depth, int levels, int threads,
+                          const std::atomic<bool> * stop = nullptr);
+
+//prints the divide of the root and, if a reference is given, descends into the
+//first move whose count differs until the reference runs out or depth 1 shows
+//which moves are missing or extra, writing each line through output. Returns the
+//path of the mismatch, empty if none or stopped
+std::string perft_diagnose(const Bitboard_Gen & root, int depth, int threads, const std::map<std::string, U64> * reference,
+                           const std::function<void(const std::string &)> & output, const std::atomic<bool> * stop = nullptr);
+
+#endif
@@ -0,0 +1,54 @@
+//
+//  polyglot.h
+//  InvincibleSummer
+//
+//  Polyglot .bin opening books. The book file is memory mapped and searched in
+//  place: entries are 16 bytes, big endian, sorted by key. The key is computed
+//  from the board the Polyglot way, separately from zobrist_hash, with the 781
+//  Random64 constants of the format built in.
+//
+#include "bitboard_gen.h"
+#include <string>
+
+#ifndef POLYGLOT
+#define POLYGLOT
+
+#define POLYGLOT_NUM_RANDOMS 781
+#define POLYGLOT_CASTLE_OFFSET 768
+#define POLYGLOT_EP_OFFSET 772
+#define POLYGLOT_TURN_OFFSET 780
+#define POLYGLOT_ENTRY_SIZE 16
+#define POLYGLOT_MAX_MOVES 64
+
+struct polyglot_entry{
+    U64 key;
+    uint16_t move; //polyglot encoding, see to_move
+    uint16_t weight;
+    uint32_t learn;
+};
+
+class Polyglot_Book{
+public:
+    ~Polyglot_Book();
+
+    bool open(const std::string & path);
+    void close();
+    bool ready() const { return base; }
+
+    U64 key(Bitboard_Gen & board) const;
+    //legal book moves in our encoding with their weights, returns how many were found
+    int probe(Bitboard_Gen & board, uint16_t * moves, int * weights, int max_moves = POLYGLOT_MAX_MOVES);
+    //weighted random choice among the book moves, 0 when out of book
+    uint16_t pick(Bitboard_Gen & board, U64 random);
+    //translates a book move, 0 if it is not legal in the position
+    static uint16_t to_move(Bitboard_Gen & board, uint16_t book_move);
+
+private:
+    const uint8_t * base = nullptr;
+    size_t size = 0;
+    size_t num_entries = 0;
+
+    polyglot_entry entry(size_t index) const;
+};
+
+#endif
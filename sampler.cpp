@@ -0,0 +1,183 @@
+//
+//  sampler.cpp
+//  InvincibleSummer
+//
+
+#include "sampler.h"
+#include "evaluate.h"
+#include "utility.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#define SAMPLER_START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define SAMPLER_BUFFER_POSITIONS 4096
+
+void pack_position(Bitboard_Gen & board, int plies, uint8_t * record){
+    U64 occupied = board.bitboards[WHITE] | board.bitboards[BLACK];
+    for(int i = 0; i < 8; i++)
+        record[i] = (uint8_t) (occupied >> (8 * i));
+    uint8_t * pieces = record + 8;
+    std::fill(pieces, pieces + 16, 0);
+    for(int count = 0; occupied; count++){
+        int square = board.pop_lsb(&occupied);
+        if(count < 32)
+            pieces[count >> 1] |= board.mailbox[square] << ((count & 1) * 4);
+    }
+    const game_state & state = board.game_history[board.ply];
+    record[24] = (uint8_t) (board.current_side << 4 | state.castling_rights);
+    record[25] = (uint8_t) state.ep_target;
+    record[26] = (uint8_t) plies;
+    record[27] = (uint8_t) (plies >> 8);
+}
+
+int unpack_position(Bitboard_Gen & board, const uint8_t * record){
+    U64 occupied = 0;
+    for(int i = 0; i < 8; i++)
+        occupied |= (U64) record[i] << (8 * i);
+    board.clear_board();
+    for(int count = 0; occupied; count++){
+        int square = board.pop_lsb(&occupied);
+        int piece = (record[8 + (count >> 1)] >> ((count & 1) * 4)) & 0x0f;
+        board.bitboards[piece & 1] |= 1ULL << square;
+        board.bitboards[piece >> 1] |= 1ULL << square;
+    }
+    board.rebuild_from_bitboards(record[24] >> 4, record[24] & 0x0f, record[25]);
+    return record[26] | record[27] << 8;
+}
+
+//whether the side to move can win material with a single legal capture
+static bool has_hanging_capture(Bitboard_Gen & board){
+    uint16_t move_list[256];
+    int num_moves = board.generate_captures(move_list);
+    for(int i = 0; i < num_moves; i++){
+        uint16_t move = move_list[i];
+        int dest = (move >> 4) & 0x3f;
+        int victim = (move & 0x0f) == EN_PASSANT_FLAG ? PAWN_BOARD : board.mailbox[dest] >> 1;
+        int attacker = board.mailbox[(move >> 10) & 0x3f] >> 1;
+        board.make_move(move);
+        bool winning = false;
+        if(!board.is_move_legal()){
+            //a legal king capture already means the victim was undefended
+            winning = attacker == KING_BOARD || piece_values[victim] > piece_values[attacker]
+                || !board.square_attacked(dest, board.current_side);
+        }
+        board.unmake_move(move);
+        if(winning)
+            return true;
+    }
+    return false;
+}
+
+//makes a random legal move, captures weighted, false when there is none
+static bool random_move(Bitboard_Gen & board, PRNG & rng, int capture_weight, uint16_t * played){
+    uint16_t move_list[256];
+    int num_moves = board.generate_moves(move_list);
+    while(num_moves){
+        int index;
+        if(capture_weight > 1){
+            int total = 0;
+            for(int i = 0; i < num_moves; i++)
+                total += (move_list[i] & CAPTURE_FLAG) ? capture_weight : 1;
+            int choice = (int) (rng.rand64() % total);
+            for(index = 0; index < num_moves - 1; index++){
+                choice -= (move_list[index] & CAPTURE_FLAG) ? capture_weight : 1;
+                if(choice < 0)
+                    break;
+            }
+        }else{
+            index = (int) (rng.rand64() % num_moves);
+        }
+        uint16_t move = move_list[index];
+        board.make_move(move);
+        if(!board.is_move_legal()){
+            *played = move;
+            return true;
+        }
+        board.unmake_move(move);
+        move_list[index] = move_list[--num_moves];
+    }
+    return false;
+}
+
+sampler_stats sample_positions(const sampler_options & options, std::ostream & out){
+    std::vector<std::string> seeds = options.seeds;
+    if(seeds.empty())
+        seeds.push_back(SAMPLER_START_FEN);
+    int min_ply = std::max(0, std::min(options.min_ply, 390));
+    int max_ply = std::max(min_ply, std::min(options.max_ply, 390));
+
+    sampler_stats stats;
+    std::mutex out_mutex;
+    std::atomic<bool> done{options.positions == 0};
+    auto start = std::chrono::steady_clock::now();
+
+    auto worker = [&](int id){
+        PRNG rng(options.seed + (U64) id * 0x9e3779b97f4a7c15ULL);
+        Bitboard_Gen board(seeds[0]);
+        std::vector<uint8_t> buffer;
+        buffer.reserve(SAMPLER_BUFFER_POSITIONS * SAMPLE_RECORD_SIZE);
+        uint16_t played[400];
+        U64 playouts = 0, plies = 0;
+
+        //appends the buffer under the lock, stopping everyone once enough are written
+        auto flush = [&](){
+            std::lock_guard<std::mutex> lock(out_mutex);
+            U64 records = buffer.size() / SAMPLE_RECORD_SIZE;
+            records = std::min<U64>(records, options.positions - stats.positions);
+            if(records && !done.load()){
+                out.write((const char *) buffer.data(), records * SAMPLE_RECORD_SIZE);
+                stats.positions += records;
+            }
+            if(stats.positions >= options.positions || !out)
+                done.store(true);
+            buffer.clear();
+        };
+
+        while(!done.load(std::memory_order_relaxed)){
+            if(seeds.size() > 1)
+                board.set_board(seeds[rng.rand64() % seeds.size()]);
+            //one position per playout at a uniformly random ply keeps the samples apart,
+            //a stride trades that for every stride-th position of a full playout
+            int target = min_ply + (int) (rng.rand64() % (max_ply - min_ply + 1));
+            int ply = 0;
+            bool sampled = false;
+            while(true){
+                if(ply >= min_ply && (options.stride ? (ply - min_ply) % options.stride == 0 : ply >= target)
+                   && !(options.skip_in_check && board.position_in_check())
+                   && !(options.skip_hanging && has_hanging_capture(board))){
+                    buffer.resize(buffer.size() + SAMPLE_RECORD_SIZE);
+                    pack_position(board, ply, buffer.data() + buffer.size() - SAMPLE_RECORD_SIZE);
+                    if(buffer.size() == SAMPLER_BUFFER_POSITIONS * SAMPLE_RECORD_SIZE)
+                        flush();
+                    sampled = true;
+                }
+                //a target that fails the filters moves on to the next ply that passes
+                if((sampled && !options.stride) || ply == max_ply || !random_move(board, rng, options.capture_weight, &played[ply]))
+                    break;
+                ply++;
+            }
+            playouts++;
+            plies += ply;
+            //back to the seed without parsing it again
+            while(ply > 0){
+                ply--;
+                board.unmake_move(played[ply]);
+            }
+        }
+        flush();
+        std::lock_guard<std::mutex> lock(out_mutex);
+        stats.playouts += playouts;
+        stats.plies += plies;
+    };
+    std::vector<std::thread> pool;
+    for(int i = 1; i < options.threads; i++)
+        pool.emplace_back(worker, i);
+    worker(0);
+    for(auto & thread : pool)
+        thread.join();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
@@ -0,0 +1,62 @@
+//
+//  sampler.h
+//  InvincibleSummer
+//
+//  Training position sampler. Threads play random games from the start position
+//  or seed EPDs with generate_moves and a legality check, each with its own PRNG,
+//  and every position in the ply range that passes the filters is packed and
+//  written to a binary stream. Threads fill a local buffer and append it under
+//  a lock, so the stream order varies between runs with more than one thread.
+//  One position per playout costs a whole random game, tens of thousands of
+//  positions/s per thread. Only stride mode, which keeps every nth ply of each
+//  playout, gets to millions of positions/s.
+//
+//  Record format, 28 bytes, little endian:
+//      uint64 occupied squares
+//      uint8  pieces[16], the piece codes of the occupied squares from a1 up,
+//             4 bits each, low nibble first
+//      uint8  side to move << 4 | castling rights
+//      uint8  ep_target, the square of the pawn that just moved two, 0 for none
+//      uint16 plies played from the seed position
+//
+#include "bitboard_gen.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef SAMPLER
+#define SAMPLER
+
+#define SAMPLE_RECORD_SIZE 28
+
+struct sampler_options{
+    U64 positions = 1000000;
+    int threads = 1;
+    int min_ply = 8;
+    int max_ply = 120;  //game_history holds 400 plies
+    bool skip_in_check = false;
+    //skip positions where the side to move can capture an undefended or more valuable piece
+    bool skip_hanging = false;
+    //a capture is this many times as likely to be played as a quiet move, 1 for uniform
+    int capture_weight = 1;
+    //0 samples one position per playout, n every nth ply of a playout to max_ply
+    int stride = 0;
+    U64 seed = 1070372;
+    std::vector<std::string> seeds;  //fens to start from, the start position when empty
+};
+
+struct sampler_stats{
+    U64 positions = 0;
+    U64 playouts = 0;
+    U64 plies = 0;
+    double seconds = 0;
+};
+
+void pack_position(Bitboard_Gen & board, int plies, uint8_t * record);
+//the board needs its zobrist keys, the plies played are returned
+int unpack_position(Bitboard_Gen & board, const uint8_t * record);
+
+//writes options.positions records to out, or fewer if out fails
+sampler_stats sample_positions(const sampler_options & options, std::ostream & out);
+
+#endif
@@ -0,0 +1,483 @@
+//
+//  search.cpp
+//  InvincibleSummer
+//
+
+#include "search.h"
+#include "evaluate.h"
+#include <thread>
+
+//mate scores are stored relative to the node so they stay valid at any ply
+static inline int score_to_tt(int score, int ply_from_root){
+    if(score >= MATE_BOUND)
+        return score + ply_from_root;
+    if(score <= -MATE_BOUND)
+        return score - ply_from_root;
+    return score;
+}
+
+static inline int score_from_tt(int score, int ply_from_root){
+    if(score >= MATE_BOUND)
+        return score - ply_from_root;
+    if(score <= -MATE_BOUND)
+        return score + ply_from_root;
+    return score;
+}
+
+//moves the highest scored move left in the list to index
+static inline void pick_move(uint16_t * move_list, int * scores, int num_moves, int index){
+    int best = index;
+    for(int i = index + 1; i < num_moves; i++){
+        if(scores[i] > scores[best])
+            best = i;
+    }
+    std::swap(move_list[index], move_list[best]);
+    std::swap(scores[index], scores[best]);
+}
+
+Search_Thread::Search_Thread(Searcher * owner, int thread_id) : searcher(owner), id(thread_id), ordering(new Move_Ordering()){}
+
+int Search_Thread::evaluate(){
+    if(accumulator)
+        return accumulator->evaluate(board);
+    return ::evaluate(board);
+}
+
+//two fold repetition since the last capture, looking back at most 100 plies
+bool Search_Thread::is_repetition(){
+    int i = board.ply;
+    while(i > 0 && i > board.ply - 100){
+        //nothing before a capture can come back
+        if(board.game_history[i].captured)
+            return false;
+        i--;
+        if(!((board.ply - i) & 1) && board.hash_history[i] == board.zobrist_hash)
+            return true;
+    }
+    return false;
+}
+
+//only the main thread looks at the clock, every thread watches the stop flag
+bool Search_Thread::check_limits(){
+    if(id == 0 && !(nodes.load(std::memory_order_relaxed) & 1023)){
+        const search_limits & limits = searcher->limits;
+        if(!limits.infinite && !searcher->pondering.load(std::memory_order_relaxed)){
+            if(limits.movetime && searcher->search_time() >= limits.movetime)
+                searcher->stop_flag.store(true, std::memory_order_relaxed);
+            if(limits.nodes && searcher->total_nodes() >= limits.nodes)
+                searcher->stop_flag.store(true, std::memory_order_relaxed);
+        }
+    }
+    return searcher->stop_flag.load(std::memory_order_relaxed);
+}
+
+//hash move, captures by most valuable victim / least valuable attacker, promotions,
+//killers, the countermove, then the other quiets by history
+int Search_Thread::score_move(uint16_t move, uint16_t tt_move, int ply_from_root){
+    if(move == tt_move)
+        return 1 << 30;
+    int flag = move & 0x0f;
+    int piece = board.mailbox[(move >> 10) & 0x3f];
+    int score = 0;
+    if(flag & CAPTURE_FLAG){
+        int victim = flag == EN_PASSANT_FLAG ? PAWN_BOARD : board.mailbox[(move >> 4) & 0x3f] >> 1;
+        score += (1 << 26) + piece_values[victim] * 8 - (piece >> 1);
+    }
+    if(flag & 8)
+        score += (1 << 25) + piece_values[(flag & 3) + BISHOP_BOARD];
+    if(score)
+        return score;
+
+    int prev_piece = ply_from_root ? moved_piece[ply_from_root - 1] : 0;
+    int prev_dest = ply_from_root ? moved_dest[ply_from_root - 1] : 0;
+    if(move == ordering->killers[ply_from_root][0])
+        return (1 << 24) + 1;
+    if(move == ordering->killers[ply_from_root][1])
+        return 1 << 24;
+    if(prev_piece && move == ordering->countermoves[prev_piece][prev_dest])
+        return 1 << 23;
+    return ordering->quiet_score(piece, (move >> 4) & 0x3f, prev_piece, prev_dest);
+}
+
+int Search_Thread::search(int alpha, int beta, int depth, int ply_from_root, bool null_allowed){
+    bool root = ply_from_root == 0;
+    bool pv_node = beta - alpha > 1;
+    pv_length[ply_from_root] = 0;
+    if(check_limits())
+        return 0;
+    if(!root){
+        if(is_repetition())
+            return 0;
+        if(ply_from_root >= MAX_PLY - 1 || board.ply >= 398)
+            return evaluate();
+        //mate distance pruning
+        alpha = std::max(alpha, -MATE_SCORE + ply_from_root);
+        beta = std::min(beta, MATE_SCORE - ply_from_root - 1);
+        if(alpha >= beta)
+            return alpha;
+        //exact distance to mate once the material is in a table
+        int wdl, dtm;
+        if(searcher->tablebase && board.popcount(board.bitboards[WHITE] | board.bitboards[BLACK]) <= TB_MAX_PIECES
+           && searcher->tablebase->probe(board, wdl, dtm)){
+            if(wdl == TB_WIN)
+                return MATE_SCORE - ply_from_root - dtm;
+            if(wdl == TB_LOSS)
+                return -MATE_SCORE + ply_from_root + dtm;
+            return 0;
+        }
+    }
+
+    bool in_check = board.position_in_check();
+    if(in_check)
+        depth++;
+    if(depth <= 0)
+        return quiescence(alpha, beta, ply_from_root, in_check);
+    count_node();
+
+    tt_data entry;
+    uint16_t tt_move = 0;
+    if(searcher->tt.probe(board.zobrist_hash, entry)){
+        tt_move = entry.move;
+        int tt_score = score_from_tt(entry.score, ply_from_root);
+        if(!pv_node && entry.depth >= depth
+           && (entry.bound == TT_BOUND_EXACT
+               || (entry.bound == TT_BOUND_LOWER && tt_score >= beta)
+               || (entry.bound == TT_BOUND_UPPER && tt_score <= alpha)))
+            return tt_score;
+    }
+
+    //null move pruning, skipped in pawn endings because of zugzwang
+    U64 non_pawn_material = board.bitboards[board.current_side]
+        & (board.bitboards[KNIGHT_BOARD] | board.bitboards[BISHOP_BOARD] | board.bitboards[ROOK_BOARD] | board.bitboards[QUEEN_BOARD]);
+    if(!pv_node && !in_check && null_allowed && depth >= 3 && non_pawn_material && evaluate() >= beta){
+        int reduction = depth > 6 ? 3 : 2;
+        moved_piece[ply_from_root] = 0;
+        board.make_null_move();
+        int score = -search(-beta, -beta + 1, depth - 1 - reduction, ply_from_root + 1, false);
+        board.unmake_null_move();
+        if(searcher->stop_flag.load(std::memory_order_relaxed))
+            return 0;
+        if(score >= beta)
+            return score >= MATE_BOUND ? beta : score;
+    }
+
+    //the hash move is tried before anything is generated, a cutoff on it skips generation
+    uint16_t move_list[256];
+    int scores[256];
+    int num_moves = 0;
+    bool generated = !(tt_move && board.is_pseudo_legal(tt_move));
+    if(generated){
+        num_moves = board.generate_moves(move_list);
+        for(int i = 0; i < num_moves; i++)
+            scores[i] = score_move(move_list[i], tt_move, ply_from_root);
+    }else{
+        scores[num_moves] = 0;
+        move_list[num_moves++] = tt_move;
+    }
+
+    int original_alpha = alpha;
+    int best_score = -INF_SCORE;
+    uint16_t best_move = 0;
+    int legal_moves = 0;
+    uint16_t quiets_tried[256];
+    int num_quiets = 0;
+    for(int i = 0; i < num_moves || !generated; i++){
+        if(i == num_moves){
+            //hash move done, generate the rest behind it
+            num_moves = i + board.generate_moves(move_list + i);
+            for(int j = i; j < num_moves; j++){
+                if(move_list[j] == tt_move)
+                    move_list[j--] = move_list[--num_moves];
+                else
+                    scores[j] = score_move(move_list[j], 0, ply_from_root);
+            }
+            generated = true;
+            if(i == num_moves)
+                break;
+        }
+        pick_move(move_list, scores, num_moves, i);
+        uint16_t move = move_list[i];
+        bool quiet = !(move & (CAPTURE_FLAG | 8));
+        moved_piece[ply_from_root] = board.mailbox[(move >> 10) & 0x3f];
+        moved_dest[ply_from_root] = (move >> 4) & 0x3f;
+        board.make_move(move);
+        //is_move_legal is true when the side that just moved left its king en prise
+        if(board.is_move_legal()){
+            board.unmake_move(move);
+            continue;
+        }
+        legal_moves++;
+        if(quiet)
+            quiets_tried[num_quiets++] = move;
+        int score;
+        if(legal_moves == 1){
+            score = -search(-beta, -alpha, depth - 1, ply_from_root + 1, true);
+        }else{
+            score = -search(-alpha - 1, -alpha, depth - 1, ply_from_root + 1, true);
+            if(score > alpha && score < beta)
+                score = -search(-beta, -alpha, depth - 1, ply_from_root + 1, true);
+        }
+        board.unmake_move(move);
+        if(searcher->stop_flag.load(std::memory_order_relaxed))
+            return 0;
+
+        if(score > best_score){
+            best_score = score;
+            if(score > alpha){
+                alpha = score;
+                best_move = move;
+                pv[ply_from_root][0] = move;
+                for(int j = 0; j < pv_length[ply_from_root + 1]; j++)
+                    pv[ply_from_root][j + 1] = pv[ply_from_root + 1][j];
+                pv_length[ply_from_root] = pv_length[ply_from_root + 1] + 1;
+                if(alpha >= beta){
+                    if(quiet)
+                        ordering->update_quiets(board, move, quiets_tried, num_quiets,
+                                                ply_from_root ? moved_piece[ply_from_root - 1] : 0,
+                                                ply_from_root ? moved_dest[ply_from_root - 1] : 0,
+                                                ply_from_root, depth);
+                    break;
+                }
+            }
+        }
+    }
+    if(!legal_moves)
+        return in_check ? -MATE_SCORE + ply_from_root : 0;
+
+    int bound = best_score >= beta ? TT_BOUND_LOWER : (alpha > original_alpha ? TT_BOUND_EXACT : TT_BOUND_UPPER);
+    searcher->tt.store(board.zobrist_hash, best_move, score_to_tt(best_score, ply_from_root), 0, depth, bound);
+    return best_score;
+}
+
+//captures only, ordered by mvv-lva, with every evasion searched when in check.
+//the caller says whether the side to move is in check, found with gives_check
+int Search_Thread::quiescence(int alpha, int beta, int ply_from_root, bool in_check){
+    count_node();
+    qnodes.store(qnodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    pv_length[ply_from_root] = 0;
+    if(check_limits())
+        return 0;
+    if(ply_from_root >= MAX_PLY - 1 || board.ply >= 398)
+        return evaluate();
+
+    //in check there is no standing pat, the king has to get out
+    int stand_pat = -MATE_SCORE + ply_from_root;
+    int best_score = stand_pat;
+    if(!in_check){
+        stand_pat = best_score = evaluate();
+        if(best_score >= beta)
+            return best_score;
+        if(best_score > alpha)
+            alpha = best_score;
+    }
+
+    uint16_t move_list[256];
+    int scores[256];
+    int num_moves = in_check ? board.generate_moves(move_list) : board.generate_captures(move_list);
+    for(int i = 0; i < num_moves; i++)
+        scores[i] = score_move(move_list[i], 0, ply_from_root);
+
+    //only filled once a move gets past delta pruning, most nodes stand pat before that
+    check_info info;
+    bool have_info = false;
+    for(int i = 0; i < num_moves; i++){
+        pick_move(move_list, scores, num_moves, i);
+        uint16_t move = move_list[i];
+        int flag = move & 0x0f;
+        //delta pruning, skip captures that cannot lift the score to alpha even with a margin
+        if(!in_check){
+            int gain = flag == EN_PASSANT_FLAG ? piece_values[PAWN_BOARD] : piece_values[board.mailbox[(move >> 4) & 0x3f] >> 1];
+            if(flag & 8)
+                gain += piece_values[(flag & 3) + BISHOP_BOARD] - piece_values[PAWN_BOARD];
+            if(stand_pat + gain + QSEARCH_DELTA_MARGIN <= alpha)
+                continue;
+        }
+        if(!have_info){
+            board.compute_check_info(info);
+            have_info = true;
+        }
+        bool check = board.gives_check(move, info);
+        //evasions below can be ordered by countermove and continuation history too
+        moved_piece[ply_from_root] = board.mailbox[(move >> 10) & 0x3f];
+        moved_dest[ply_from_root] = (move >> 4) & 0x3f;
+        board.make_move(move);
+        if(board.is_move_legal()){
+            board.unmake_move(move);
+            continue;
+        }
+        int score = -quiescence(-beta, -alpha, ply_from_root + 1, check);
+        board.unmake_move(move);
+        if(searcher->stop_flag.load(std::memory_order_relaxed))
+            return 0;
+        if(score > best_score){
+            best_score = score;
+            if(score > alpha){
+                alpha = score;
+                if(alpha >= beta)
+                    break;
+            }
+        }
+    }
+    return best_score;
+}
+
+void Search_Thread::iterative_deepening(){
+    const search_limits & limits = searcher->limits;
+    for(int depth = 1; depth <= limits.depth; depth++){
+        //odd helper threads run one ply ahead so the threads spread over two depths
+        int search_depth = std::min(depth + (id & 1), limits.depth);
+        int score = search(-INF_SCORE, INF_SCORE, search_depth, 0, false);
+        if(searcher->stop_flag.load(std::memory_order_relaxed))
+            break;
+        completed_depth = search_depth;
+        best_score = score;
+        root_pv.assign(pv[0], pv[0] + pv_length[0]);
+
+        if(id == 0){
+            if(searcher->on_iteration){
+                search_info info;
+                info.depth = search_depth;
+                info.score = score;
+                info.nodes = searcher->total_nodes();
+                info.time = searcher->elapsed();
+                info.nps = info.nodes * 1000 / (info.time ? info.time : 1);
+                info.hashfull = searcher->tt.hashfull();
+                info.pv = root_pv;
+                searcher->on_iteration(info);
+            }
+            bool timed = !limits.infinite && !searcher->pondering.load(std::memory_order_relaxed);
+            //not enough time left to finish another iteration
+            if(timed && limits.movetime && searcher->search_time() * 2 >= limits.movetime)
+                break;
+            if(timed && limits.nodes && searcher->total_nodes() >= limits.nodes)
+                break;
+            //no legal moves at the root
+            if(root_pv.empty())
+                break;
+        }
+    }
+}
+
+//fallback when the search is stopped before the first iteration finishes
+static uint16_t first_legal_move(Bitboard_Gen & board){
+    uint16_t move_list[256];
+    int num_moves = board.generate_moves(move_list);
+    for(int i = 0; i < num_moves; i++){
+        board.make_move(move_list[i]);
+        bool illegal = board.is_move_legal();
+        board.unmake_move(move_list[i]);
+        if(!illegal)
+            return move_list[i];
+    }
+    return 0;
+}
+
+Searcher::Searcher(){
+    set_threads(1);
+}
+
+void Searcher::set_threads(int count){
+    threads.clear();
+    for(int i = 0; i < std::max(count, 1); i++)
+        threads.emplace_back(new Search_Thread(this, i));
+    set_network(network);
+}
+
+void Searcher::set_hash(size_t megabytes){
+    tt.resize(megabytes, (int) threads.size());
+}
+
+void Searcher::set_network(const NNUE_Network * net){
+    network = net;
+    for(auto & thread : threads)
+        thread->accumulator.reset(net ? new NNUE_Accumulator(net) : nullptr);
+}
+
+void Searcher::clear(){
+    tt.clear((int) threads.size());
+    for(auto & thread : threads)
+        thread->ordering->clear();
+}
+
+search_result Searcher::search(const Bitboard_Gen & root, const search_limits & search_limits, bool ponder){
+    limits = search_limits;
+    start_time = std::chrono::steady_clock::now();
+    time_offset.store(0);
+    pondering.store(ponder);
+    stop_flag.store(false);
+    tt.new_search();
+    for(auto & thread : threads){
+        thread->board = root;
+        thread->board.nnue = thread->accumulator.get();
+        if(thread->accumulator)
+            thread->accumulator->reset();
+        thread->nodes.store(0);
+        thread->qnodes.store(0);
+        thread->completed_depth = 0;
+        thread->root_pv.clear();
+        thread->ordering->clear_killers();
+    }
+
+    std::vector<std::thread> helpers;
+    for(size_t i = 1; i < threads.size(); i++)
+        helpers.emplace_back(&Search_Thread::iterative_deepening, threads[i].get());
+    threads[0]->iterative_deepening();
+    //uci expects infinite and ponder searches to hold the best move until told otherwise
+    while((limits.infinite || pondering.load()) && !stop_flag.load())
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    stop_flag.store(true);
+    for(auto & helper : helpers)
+        helper.join();
+
+    //deepest finished iteration wins, the main thread on ties
+    Search_Thread * best = threads[0].get();
+    for(auto & thread : threads){
+        if(!thread->root_pv.empty() && (best->root_pv.empty() || thread->completed_depth > best->completed_depth))
+            best = thread.get();
+    }
+    search_result result;
+    if(!best->root_pv.empty())
+        result.best_move = best->root_pv[0];
+    else
+        result.best_move = first_legal_move(threads[0]->board);
+    if(best->root_pv.size() > 1)
+        result.ponder_move = best->root_pv[1];
+    result.score = best->best_score;
+    result.depth = best->completed_depth;
+    result.nodes = total_nodes();
+    result.qnodes = total_qnodes();
+    result.time = elapsed();
+    result.nps = result.nodes * 1000 / (result.time ? result.time : 1);
+    return result;
+}
+
+void Searcher::stop(){
+    stop_flag.store(true);
+}
+
+void Searcher::ponderhit(){
+    time_offset.store(elapsed());
+    pondering.store(false);
+}
+
+U64 Searcher::total_nodes() const{
+    U64 total = 0;
+    for(auto & thread : threads)
+        total += thread->nodes.load(std::memory_order_relaxed);
+    return total;
+}
+
+U64 Searcher::total_qnodes() const{
+    U64 total = 0;
+    for(auto & thread : threads)
+        total += thread->qnodes.load(std::memory_order_relaxed);
+    return total;
+}
+
+int64_t Searcher::elapsed() const{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+int64_t Searcher::search_time() const{
+    return elapsed() - time_offset.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,135 @@
+//
+//  search.h
+//  InvincibleSummer
+//
+//  Iterative deepening principal variation search, run as Lazy SMP: every
+//  thread searches the same root on its own board and they cooperate only
+//  through the shared transposition table.
+//
+#include "bitboard_gen.h"
+#include "transposition.h"
+#include "nnue.h"
+#include "tablebase.h"
+#include "move_order.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#ifndef SEARCH
+#define SEARCH
+
+#define MAX_PLY 128
+#define INF_SCORE 32000
+#define MATE_SCORE 31000
+#define MATE_BOUND (MATE_SCORE - MAX_PLY)
+//a capture is skipped in quiescence when winning the piece plus this stays below alpha
+#define QSEARCH_DELTA_MARGIN 200
+
+struct search_limits{
+    int depth = MAX_PLY - 1;
+    int64_t movetime = 0; //milliseconds, 0 for no limit
+    U64 nodes = 0;        //0 for no limit
+    bool infinite = false;
+};
+
+struct search_info{
+    int depth;
+    int score;
+    U64 nodes;
+    int64_t time;  //milliseconds
+    U64 nps;
+    int hashfull;
+    std::vector<uint16_t> pv;
+};
+
+struct search_result{
+    uint16_t best_move = 0;
+    uint16_t ponder_move = 0;
+    int score = 0;
+    int depth = 0;
+    U64 nodes = 0;
+    U64 qnodes = 0;  //the part of nodes searched in quiescence
+    int64_t time = 0;
+    U64 nps = 0;
+};
+
+class Searcher;
+
+class Search_Thread{
+public:
+    Bitboard_Gen board;
+    std::unique_ptr<NNUE_Accumulator> accumulator;
+    Searcher * searcher;
+    int id;
+    std::atomic<U64> nodes{0};
+    std::atomic<U64> qnodes{0};
+
+    int completed_depth = 0;
+    int best_score = 0;
+    std::vector<uint16_t> root_pv;
+    uint16_t pv[MAX_PLY][MAX_PLY];
+    int pv_length[MAX_PLY];
+    //quiet move ordering, kept between searches until ucinewgame
+    std::unique_ptr<Move_Ordering> ordering;
+    //piece code and destination of the move made at each ply, piece 0 after a null move
+    int moved_piece[MAX_PLY];
+    int moved_dest[MAX_PLY];
+
+    Search_Thread(Searcher * owner, int thread_id);
+    void iterative_deepening();
+    int search(int alpha, int beta, int depth, int ply_from_root, bool null_allowed);
+    int quiescence(int alpha, int beta, int ply_from_root, bool in_check);
+    int evaluate();
+
+private:
+    inline void count_node(){
+        nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    bool is_repetition();
+    bool check_limits();
+    int score_move(uint16_t move, uint16_t tt_move, int ply_from_root);
+};
+
+class Searcher{
+public:
+    Transposition_Table tt;
+    std::atomic<bool> stop_flag{false};
+    //while pondering the time limits are off and the result is held back
+    std::atomic<bool> pondering{false};
+    //time already spent pondering when ponderhit arrived, not charged to movetime
+    std::atomic<int64_t> time_offset{0};
+    search_limits limits;
+    std::chrono::steady_clock::time_point start_time;
+    //called by the main thread after every completed iteration
+    std::function<void(const search_info &)> on_iteration;
+    //probed below the root, null to search endings out
+    Tablebase * tablebase = nullptr;
+
+    Searcher();
+    void set_threads(int count);
+    int get_threads() const { return (int) threads.size(); }
+    void set_hash(size_t megabytes);
+    //null to go back to the hand written evaluation
+    void set_network(const NNUE_Network * net);
+    void clear();
+
+    //blocking, returns once the limits are hit, stop() is called or the main thread is done
+    search_result search(const Bitboard_Gen & root, const search_limits & search_limits, bool ponder = false);
+    void stop();
+    //the opponent played the expected move, start the clock for the real search
+    void ponderhit();
+
+    U64 total_nodes() const;
+    U64 total_qnodes() const;
+    int64_t elapsed() const;
+    //milliseconds charged against limits.movetime
+    int64_t search_time() const;
+
+private:
+    std::vector<std::unique_ptr<Search_Thread>> threads;
+    const NNUE_Network * network = nullptr;
+};
+
+#endif
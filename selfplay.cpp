@@ -0,0 +1,203 @@
+//
+//  selfplay.cpp
+//  InvincibleSummer
+//
+
+#include "selfplay.h"
+#include "utility.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#if !defined(_WIN32)
+    #include <sys/resource.h>
+#endif
+
+#define SELFPLAY_START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+static double process_cpu_seconds(){
+#if defined(_WIN32)
+    return 0;
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage))
+        return 0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+bool load_epd_book(const std::string & path, std::vector<std::string> & fens){
+    std::ifstream file(path);
+    if(!file)
+        return false;
+    std::string line;
+    while(std::getline(file, line)){
+        //placement, side, castling and en passant, then either clocks or epd operations
+        std::istringstream fields(line);
+        std::string field[6];
+        int count = 0;
+        while(count < 6 && fields >> field[count])
+            count++;
+        if(count < 4)
+            continue;
+        bool clocks = count == 6 && std::all_of(field[4].begin(), field[4].end(), ::isdigit)
+            && std::all_of(field[5].begin(), field[5].end(), ::isdigit);
+        fens.push_back(field[0] + " " + field[1] + " " + field[2] + " " + field[3]
+                       + (clocks ? " " + field[4] + " " + field[5] : " 0 1"));
+    }
+    return !fens.empty();
+}
+
+//the position occurred twice before since the last irreversible move
+static bool threefold_repetition(Bitboard_Gen & board, int halfmove_clock){
+    int repeats = 0;
+    for(int i = board.ply - 2; i >= 0 && i >= board.ply - halfmove_clock; i -= 2){
+        if(board.hash_history[i] == board.zobrist_hash && ++repeats == 2)
+            return true;
+    }
+    return false;
+}
+
+//bare kings or a single minor piece left
+static bool insufficient_material(Bitboard_Gen & board){
+    if(board.bitboards[PAWN_BOARD] | board.bitboards[ROOK_BOARD] | board.bitboards[QUEEN_BOARD])
+        return false;
+    return board.popcount(board.bitboards[BISHOP_BOARD] | board.bitboards[KNIGHT_BOARD]) <= 1;
+}
+
+//the clock restarts on captures and pawn moves
+static int next_halfmove_clock(Bitboard_Gen & board, uint16_t move, int halfmove_clock){
+    if((move & CAPTURE_FLAG) || board.mailbox[(move >> 10) & 0x3f] >> 1 == PAWN_BOARD)
+        return 0;
+    return halfmove_clock + 1;
+}
+
+//plays up to plies random legal moves into moves, so games without a book differ
+static int random_opening(Bitboard_Gen & board, PRNG & rng, int plies, int halfmove_clock, std::vector<uint16_t> & moves){
+    for(int ply = 0; ply < plies; ply++){
+        uint16_t move_list[256];
+        int num_moves = board.generate_moves(move_list);
+        int legal = 0;
+        for(int i = 0; i < num_moves; i++){
+            board.make_move(move_list[i]);
+            if(!board.is_move_legal())
+                move_list[legal++] = move_list[i];
+            board.unmake_move(move_list[i]);
+        }
+        if(!legal)
+            break;
+        uint16_t move = move_list[rng.rand64() % legal];
+        halfmove_clock = next_halfmove_clock(board, move, halfmove_clock);
+        board.make_move(move);
+        moves.push_back(move);
+    }
+    return halfmove_clock;
+}
+
+//plays one game on from the board's position after the moves already in moves,
+//returns the result and sets reason
+static int play_game(Searcher & searcher, Bitboard_Gen & board, int halfmove_clock, const selfplay_options & options,
+                     std::vector<uint16_t> & moves, int & reason){
+    searcher.clear();
+    while(true){
+        if(!board.count_legal_moves()){
+            bool mated = board.position_in_check();
+            reason = mated ? ADJUDICATE_CHECKMATE : ADJUDICATE_STALEMATE;
+            if(!mated)
+                return SELFPLAY_DRAW;
+            return board.current_side == WHITE ? SELFPLAY_BLACK_WINS : SELFPLAY_WHITE_WINS;
+        }
+        reason = halfmove_clock >= 100 ? ADJUDICATE_FIFTY_MOVES
+            : threefold_repetition(board, halfmove_clock) ? ADJUDICATE_REPETITION
+            : insufficient_material(board) ? ADJUDICATE_MATERIAL
+            : (int) moves.size() >= options.max_plies ? ADJUDICATE_MAX_PLIES : -1;
+        if(reason >= 0)
+            return SELFPLAY_DRAW;
+
+        uint16_t move = searcher.search(board, options.limits).best_move;
+        halfmove_clock = next_halfmove_clock(board, move, halfmove_clock);
+        board.make_move(move);
+        moves.push_back(move);
+    }
+}
+
+static void write_record(std::ofstream & out, uint32_t opening, int result, int reason, const std::vector<uint16_t> & moves){
+    std::vector<uint8_t> bytes;
+    bytes.reserve(8 + moves.size() * 2);
+    for(int i = 0; i < 4; i++)
+        bytes.push_back((uint8_t) (opening >> (8 * i)));
+    bytes.push_back((uint8_t) result);
+    bytes.push_back((uint8_t) reason);
+    bytes.push_back((uint8_t) moves.size());
+    bytes.push_back((uint8_t) (moves.size() >> 8));
+    for(uint16_t move : moves){
+        bytes.push_back((uint8_t) move);
+        bytes.push_back((uint8_t) (move >> 8));
+    }
+    out.write((const char *) bytes.data(), bytes.size());
+}
+
+selfplay_stats run_selfplay(const selfplay_options & options, const std::function<void(const selfplay_stats &)> & progress){
+    std::vector<std::string> book;
+    bool random_openings = options.book_path.empty() || !load_epd_book(options.book_path, book);
+    if(random_openings)
+        book.assign(1, SELFPLAY_START_FEN);
+    std::ofstream out;
+    if(!options.output_path.empty())
+        out.open(options.output_path, std::ios::binary);
+
+    selfplay_stats stats;
+    std::mutex stats_mutex;
+    std::atomic<int> next{0};
+    auto start = std::chrono::steady_clock::now();
+    double cpu_start = process_cpu_seconds();
+
+    auto worker = [&](){
+        Searcher searcher;
+        searcher.set_hash(options.hash_megabytes);
+        Bitboard_Gen board(SELFPLAY_START_FEN);
+        std::vector<uint16_t> moves;
+        for(int game = next.fetch_add(1); game < options.games; game = next.fetch_add(1)){
+            uint32_t opening = (uint32_t) (game % book.size());
+            board.set_board(book[opening]);
+            std::istringstream fields(book[opening]);
+            std::string skip;
+            int halfmove_clock = 0;
+            fields >> skip >> skip >> skip >> skip >> halfmove_clock;
+            moves.clear();
+            if(random_openings){
+                //seeded by the game, not the thread, so a run repeats with any thread count
+                PRNG rng((options.seed + (U64) game) * 0x9e3779b97f4a7c15ULL | 1);
+                halfmove_clock = random_opening(board, rng, options.random_plies, halfmove_clock, moves);
+            }
+            int reason;
+            int result = play_game(searcher, board, halfmove_clock, options, moves, reason);
+
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            if(out.is_open())
+                write_record(out, opening, result, reason, moves);
+            stats.games++;
+            stats.results[result]++;
+            stats.reasons[reason]++;
+            stats.plies += moves.size();
+            stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            stats.cpu_seconds = process_cpu_seconds() - cpu_start;
+            if(progress)
+                progress(stats);
+        }
+    };
+    std::vector<std::thread> pool;
+    for(int i = 1; i < options.threads; i++)
+        pool.emplace_back(worker);
+    worker();
+    for(auto & thread : pool)
+        thread.join();
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.cpu_seconds = process_cpu_seconds() - cpu_start;
+    return stats;
+}
@@ -0,0 +1,70 @@
+//
+//  selfplay.h
+//  InvincibleSummer
+//
+//  In process self-play for game generation. A pool of threads each owns a
+//  Searcher and a Bitboard_Gen and plays games taken from a shared counter,
+//  opening from an EPD book, or without one from the start position and a few
+//  random legal plies seeded by the game number. Games end by checkmate, stalemate, threefold
+//  repetition from hash_history, the fifty move rule, insufficient material or
+//  a ply limit. Finished games are appended to a binary record file as they
+//  complete.
+//
+//  Record format, little endian, one after another:
+//      uint32 opening (line of the book, 0 without a book)
+//      uint8  result (SELFPLAY_*_WINS or SELFPLAY_DRAW)
+//      uint8  reason (ADJUDICATE_*)
+//      uint16 number of moves
+//      uint16 moves[number of moves], in generate_moves encoding, the random
+//             opening plies first
+//
+#include "bitboard_gen.h"
+#include "search.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef SELFPLAY
+#define SELFPLAY
+
+#define SELFPLAY_WHITE_WINS 0
+#define SELFPLAY_BLACK_WINS 1
+#define SELFPLAY_DRAW 2
+
+#define ADJUDICATE_CHECKMATE 0
+#define ADJUDICATE_STALEMATE 1
+#define ADJUDICATE_REPETITION 2
+#define ADJUDICATE_FIFTY_MOVES 3
+#define ADJUDICATE_MATERIAL 4
+#define ADJUDICATE_MAX_PLIES 5
+
+struct selfplay_options{
+    int games = 100;
+    int threads = 1;
+    search_limits limits;  //per move, the depth defaults to 4 in the uci command
+    size_t hash_megabytes = 4;  //per thread
+    int max_plies = 300;  //game_history holds 400 plies, the search needs the rest
+    std::string book_path;  //one epd or fen per line, empty for the start position
+    int random_plies = 8;  //random legal plies opening each game when there is no book
+    U64 seed = 1070372;
+    std::string output_path;  //empty to keep no records
+};
+
+struct selfplay_stats{
+    U64 games = 0;
+    U64 results[3] = {0, 0, 0};
+    U64 reasons[6] = {0, 0, 0, 0, 0, 0};
+    U64 plies = 0;
+    double seconds = 0;
+    double cpu_seconds = 0;  //user and system time of the process, 0 where unsupported
+};
+
+//reads the positions of an epd or fen file, extra epd operations are ignored
+bool load_epd_book(const std::string & path, std::vector<std::string> & fens);
+
+//plays the games and returns once all are done, progress is called under a lock
+//after every finished game
+selfplay_stats run_selfplay(const selfplay_options & options,
+                            const std::function<void(const selfplay_stats &)> & progress = nullptr);
+
+#endif
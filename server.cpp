@@ -0,0 +1,459 @@
+//
+//  server.cpp
+//  InvincibleSummer
+//
+
+#include "server.h"
+#include "uci.h"
+#include "notation.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#if defined(_WIN32)
+    #define SERVER_NO_SOCKETS
+#else
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+#define SERVER_MAX_LINE 4096
+#define SERVER_POLL_MS 100
+
+void Latency_Histogram::record(U64 ns){
+    int bucket = (int) ns;
+    if(ns >= 8){
+        int exponent = 63 - __builtin_clzll(ns);
+        bucket = 8 + (exponent - 3) * 8 + (int) ((ns >> (exponent - 3)) & 7);
+    }
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+}
+
+U64 Latency_Histogram::percentile(double fraction) const{
+    U64 target = (U64) (fraction * count()), seen = 0;
+    for(int bucket = 0; bucket < num_buckets; bucket++){
+        seen += buckets[bucket].load(std::memory_order_relaxed);
+        if(seen > target){
+            if(bucket < 8)
+                return bucket;
+            //middle of the bucket
+            int exponent = (bucket - 8) / 8 + 3;
+            U64 low = (U64) (8 + (bucket - 8) % 8) << (exponent - 3);
+            return low + ((1ULL << (exponent - 3)) >> 1);
+        }
+    }
+    return 0;
+}
+
+Board_Pool::Board_Pool(int count){
+    for(int i = 0; i < count; i++){
+        boards.emplace_back(new Bitboard_Gen(UCI_START_FEN));
+        free_boards.push_back(boards.back().get());
+    }
+}
+
+Bitboard_Gen * Board_Pool::acquire(){
+    std::lock_guard<std::mutex> guard(lock);
+    if(free_boards.empty()){
+        boards.emplace_back(new Bitboard_Gen(UCI_START_FEN));
+        return boards.back().get();
+    }
+    Bitboard_Gen * board = free_boards.back();
+    free_boards.pop_back();
+    return board;
+}
+
+void Board_Pool::release(Bitboard_Gen * board){
+    std::lock_guard<std::mutex> guard(lock);
+    free_boards.push_back(board);
+}
+
+size_t Board_Pool::size(){
+    std::lock_guard<std::mutex> guard(lock);
+    return boards.size();
+}
+
+bool valid_fen(const std::string & fen){
+    std::istringstream fields(fen);
+    std::string placement, side = "w", castling = "-", ep_square = "-";
+    fields >> placement >> side >> castling >> ep_square;
+    if(side != "w" && side != "b")
+        return false;
+    char squares[64];
+    std::memset(squares, ' ', sizeof(squares));
+    int rank = 7, file = 0, kings[2] = {0, 0};
+    for(char c : placement){
+        if(c == '/'){
+            if(file != 8 || rank == 0)
+                return false;
+            rank--;
+            file = 0;
+        }else if(c >= '1' && c <= '8'){
+            file += c - '0';
+        }else if(std::strchr("pnbrqkPNBRQK", c) && file < 8){
+            if((c == 'p' || c == 'P') && (rank == 0 || rank == 7))
+                return false;
+            if(c == 'k' || c == 'K')
+                kings[c == 'k']++;
+            squares[rank * 8 + file++] = c;
+        }else{
+            return false;
+        }
+        if(file > 8)
+            return false;
+    }
+    if(rank != 0 || file != 8 || kings[WHITE] != 1 || kings[BLACK] != 1)
+        return false;
+
+    //castling and en passant are trusted by the generator, so they must match the pieces
+    for(char c : castling){
+        if((c == 'K' && (squares[4] != 'K' || squares[7] != 'R')) || (c == 'Q' && (squares[4] != 'K' || squares[0] != 'R'))
+           || (c == 'k' && (squares[60] != 'k' || squares[63] != 'r')) || (c == 'q' && (squares[60] != 'k' || squares[56] != 'r')))
+            return false;
+    }
+    if(ep_square != "-"){
+        if(ep_square.size() != 2 || ep_square[0] < 'a' || ep_square[0] > 'h' || ep_square[1] != (side == "w" ? '6' : '3'))
+            return false;
+        int pawn = (side == "w" ? 4 : 3) * 8 + (ep_square[0] - 'a');
+        if(squares[pawn] != (side == "w" ? 'p' : 'P'))
+            return false;
+    }
+    return true;
+}
+
+Query_Server::connection::~connection(){
+#if !defined(SERVER_NO_SOCKETS)
+    close(fd);
+#endif
+}
+
+Query_Server::Query_Server(const server_options & server_options) : options(server_options), pool(std::max(1, server_options.threads)){
+    options.threads = std::max(1, options.threads);
+    options.batch_size = std::max(1, options.batch_size);
+    if(options.cache_megabytes)
+        cache.reset(new Move_Cache(options.cache_megabytes));
+}
+
+Query_Server::~Query_Server(){
+    stop();
+}
+
+void Query_Server::stop(){
+    stop_flag.store(true, std::memory_order_relaxed);
+}
+
+server_stats Query_Server::stats(){
+    server_stats result;
+    result.queries = queries.load(std::memory_order_relaxed);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    result.p50_ns = latency.percentile(0.5);
+    result.p99_ns = latency.percentile(0.99);
+    if(cache)
+        result.cache = cache->stats();
+    return result;
+}
+
+template <typename T>
+static void append_binary(std::string & out, T value){
+    out.append((const char *) &value, sizeof(value));
+}
+
+//frame header with a placeholder length, filled in by end_frame
+static size_t begin_frame(std::string & out, uint32_t seq, uint8_t kind){
+    size_t start = out.size();
+    append_binary<uint32_t>(out, 0);
+    append_binary(out, seq);
+    append_binary(out, kind);
+    return start;
+}
+
+static void end_frame(std::string & out, size_t start){
+    uint32_t length = (uint32_t) (out.size() - start - sizeof(uint32_t));
+    std::memcpy(&out[start], &length, sizeof(length));
+}
+
+void Query_Server::execute(Bitboard_Gen & board, const query & request, std::string & out){
+    uint8_t kind = request.kind;
+    std::string error = request.text;
+    if(kind == SERVER_MOVES || kind == SERVER_PERFT || kind == SERVER_CHECK){
+        if(valid_fen(request.text)){
+            board.set_board(request.text);
+            //the side that just moved must not be left in check
+            if(board.is_move_legal()){
+                kind = SERVER_ERROR;
+                error = "side not to move is in check";
+            }
+        }else{
+            kind = SERVER_ERROR;
+            error = "bad fen";
+        }
+    }
+
+    size_t start = request.binary ? begin_frame(out, request.seq, kind) : 0;
+    if(!request.binary)
+        out += "{\"seq\":" + std::to_string(request.seq);
+    if(kind == SERVER_MOVES){
+        uint16_t move_list[256];
+        int legal = 0;
+        bool in_check;
+        if(cache){
+            legal = cache->legal_moves(board, move_list, in_check);
+        }else{
+            int num_moves = board.generate_moves(move_list);
+            for(int i = 0; i < num_moves; i++){
+                board.make_move(move_list[i]);
+                if(!board.is_move_legal())
+                    move_list[legal++] = move_list[i];
+                board.unmake_move(move_list[i]);
+            }
+        }
+        if(request.binary){
+            append_binary<uint16_t>(out, (uint16_t) legal);
+            out.append((const char *) move_list, legal * sizeof(uint16_t));
+        }else{
+            char text[MOVE_TEXT_SIZE];
+            out += ",\"moves\":[";
+            for(int i = 0; i < legal; i++){
+                out += i ? ",\"" : "\"";
+                out.append(text, to_uci(move_list[i], text));
+                out += '"';
+            }
+            out += "]";
+        }
+    }else if(kind == SERVER_PERFT){
+        U64 nodes = board.perft(request.depth);
+        if(request.binary)
+            append_binary(out, nodes);
+        else
+            out += ",\"depth\":" + std::to_string(request.depth) + ",\"perft\":" + std::to_string(nodes);
+    }else if(kind == SERVER_CHECK){
+        //the cache answers from the entry the moves request stored, or fills it
+        bool in_check;
+        if(cache){
+            uint16_t move_list[256];
+            cache->legal_moves(board, move_list, in_check);
+        }else{
+            in_check = board.position_in_check();
+        }
+        if(request.binary)
+            append_binary<uint8_t>(out, in_check);
+        else
+            out += in_check ? ",\"check\":true" : ",\"check\":false";
+    }else if(kind == SERVER_STATS){
+        server_stats current = stats();
+        U64 rate = (U64) (current.queries / (current.seconds > 0 ? current.seconds : 1e-9));
+        if(request.binary){
+            append_binary(out, current.queries);
+            append_binary(out, rate);
+            append_binary(out, current.p50_ns);
+            append_binary(out, current.p99_ns);
+            append_binary(out, current.cache.hits);
+            append_binary(out, current.cache.misses);
+        }else{
+            out += ",\"queries\":" + std::to_string(current.queries) + ",\"qps\":" + std::to_string(rate)
+                + ",\"p50_us\":" + std::to_string(current.p50_ns / 1000.0) + ",\"p99_us\":" + std::to_string(current.p99_ns / 1000.0);
+            if(cache){
+                out += ",\"cache_hits\":" + std::to_string(current.cache.hits) + ",\"cache_misses\":" + std::to_string(current.cache.misses)
+                    + ",\"cache_hit_rate\":" + std::to_string(current.cache.hit_rate()) + ",\"cache_entries\":" + std::to_string(current.cache.entries);
+            }
+        }
+    }else{
+        //messages are our own, nothing in them needs escaping
+        if(request.binary)
+            out += error;
+        else
+            out += ",\"error\":\"" + error + "\"";
+    }
+    if(request.binary)
+        end_frame(out, start);
+    else
+        out += "}\n";
+}
+
+void Query_Server::worker(){
+    std::vector<query> batch;
+    std::vector<std::pair<connection *, std::string>> replies;
+    while(true){
+        {
+            std::unique_lock<std::mutex> guard(queue_lock);
+            queue_ready.wait(guard, [this]{ return draining || !pending.empty(); });
+            if(pending.empty())
+                return;
+            while(!pending.empty() && (int) batch.size() < options.batch_size){
+                batch.push_back(std::move(pending.front()));
+                pending.pop_front();
+            }
+        }
+
+        //replies are gathered per connection so each gets one write per batch
+        Bitboard_Gen * board = pool.acquire();
+        for(const query & request : batch){
+            size_t slot = 0;
+            while(slot < replies.size() && replies[slot].first != request.client.get())
+                slot++;
+            if(slot == replies.size())
+                replies.emplace_back(request.client.get(), std::string());
+            execute(*board, request, replies[slot].second);
+        }
+        pool.release(board);
+
+#if !defined(SERVER_NO_SOCKETS)
+        for(auto & reply : replies){
+            std::lock_guard<std::mutex> guard(reply.first->write_lock);
+            const char * data = reply.second.data();
+            size_t left = reply.second.size();
+            while(left){
+                ssize_t written = send(reply.first->fd, data, left, MSG_NOSIGNAL);
+                if(written <= 0)
+                    break;
+                data += written;
+                left -= written;
+            }
+        }
+#endif
+        auto finished = std::chrono::steady_clock::now();
+        for(const query & request : batch)
+            latency.record((U64) std::chrono::duration_cast<std::chrono::nanoseconds>(finished - request.received).count());
+        queries.fetch_add(batch.size(), std::memory_order_relaxed);
+        batch.clear();
+        replies.clear();
+    }
+}
+
+void Query_Server::parse_request(const std::shared_ptr<connection> & client, const std::string & line){
+    std::istringstream fields(line);
+    std::string command;
+    if(!(fields >> command))
+        return;
+    if(command == "format"){
+        std::string format;
+        fields >> format;
+        client->binary = format == "binary";
+        return;
+    }
+    if(command == "shutdown"){
+        stop();
+        return;
+    }
+
+    query request;
+    request.client = client;
+    request.seq = client->next_seq++;
+    request.binary = client->binary;
+    request.depth = 0;
+    request.received = std::chrono::steady_clock::now();
+    if(command == "moves") request.kind = SERVER_MOVES;
+    else if(command == "perft") request.kind = SERVER_PERFT;
+    else if(command == "check") request.kind = SERVER_CHECK;
+    else if(command == "stats") request.kind = SERVER_STATS;
+    else{
+        request.kind = SERVER_ERROR;
+        request.text = "unknown request " + command;
+    }
+    if(request.kind == SERVER_PERFT && (!(fields >> request.depth) || request.depth < 1 || request.depth > options.max_perft_depth)){
+        request.kind = SERVER_ERROR;
+        request.text = "perft depth must be 1 to " + std::to_string(options.max_perft_depth);
+    }
+    if(request.kind == SERVER_MOVES || request.kind == SERVER_PERFT || request.kind == SERVER_CHECK){
+        std::getline(fields >> std::ws, request.text);
+    }
+
+    std::lock_guard<std::mutex> guard(queue_lock);
+    pending.push_back(std::move(request));
+    queue_ready.notify_one();
+}
+
+#if defined(SERVER_NO_SOCKETS)
+
+bool Query_Server::read_requests(const std::shared_ptr<connection> & client){
+    return false;
+}
+
+bool Query_Server::run(){
+    return false;
+}
+
+#else
+
+bool Query_Server::read_requests(const std::shared_ptr<connection> & client){
+    char buffer[SERVER_MAX_LINE];
+    ssize_t received = recv(client->fd, buffer, sizeof(buffer), 0);
+    if(received <= 0)
+        return false;
+    client->input.append(buffer, received);
+    size_t begin = 0, end;
+    while((end = client->input.find('\n', begin)) != std::string::npos){
+        size_t length = end - begin;
+        if(length && client->input[end - 1] == '\r')
+            length--;
+        parse_request(client, client->input.substr(begin, length));
+        begin = end + 1;
+    }
+    client->input.erase(0, begin);
+    return client->input.size() <= SERVER_MAX_LINE;
+}
+
+bool Query_Server::run(){
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(options.path.empty() || options.path.size() >= sizeof(address.sun_path))
+        return false;
+    std::strcpy(address.sun_path, options.path.c_str());
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0)
+        return false;
+    //a socket file left behind by an earlier run would make bind fail
+    unlink(options.path.c_str());
+    if(bind(listener, (sockaddr *) &address, sizeof(address)) || listen(listener, 64)){
+        close(listener);
+        return false;
+    }
+
+    start_time = std::chrono::steady_clock::now();
+    stop_flag.store(false);
+    draining = false;
+    std::vector<std::thread> workers;
+    for(int i = 0; i < options.threads; i++)
+        workers.emplace_back(&Query_Server::worker, this);
+
+    std::vector<std::shared_ptr<connection>> clients;
+    std::vector<pollfd> watched;
+    while(!stop_flag.load(std::memory_order_relaxed)){
+        watched.assign(1, pollfd{listener, POLLIN, 0});
+        for(auto & client : clients)
+            watched.push_back(pollfd{client->fd, POLLIN, 0});
+        if(poll(watched.data(), watched.size(), SERVER_POLL_MS) <= 0)
+            continue;
+        //clients first, the indices shift once a new one is added
+        for(size_t i = clients.size(); i > 0; i--){
+            if(!watched[i].revents)
+                continue;
+            if(!(watched[i].revents & POLLIN) || !read_requests(clients[i - 1]))
+                clients.erase(clients.begin() + (i - 1));
+        }
+        if(watched[0].revents & POLLIN){
+            int fd = accept(listener, nullptr, nullptr);
+            if(fd >= 0)
+                clients.push_back(std::make_shared<connection>(fd));
+        }
+    }
+
+    //answer what is queued, then let the workers go
+    {
+        std::lock_guard<std::mutex> guard(queue_lock);
+        draining = true;
+    }
+    queue_ready.notify_all();
+    for(auto & thread : workers)
+        thread.join();
+    clients.clear();
+    close(listener);
+    unlink(options.path.c_str());
+    return true;
+}
+
+#endif
@@ -0,0 +1,154 @@
+//
+//  server.h
+//  InvincibleSummer
+//
+//  Query daemon on a Unix domain socket for services that send many small
+//  questions about unrelated positions. One thread reads every connection with
+//  poll and queues whole request lines; worker threads take up to batch_size of
+//  them at a time, run them on a board from a Board_Pool that is only ever reset
+//  with set_board, and write all replies of a batch to a connection at once.
+//  With cache_megabytes set, moves and check answers go through a Move_Cache.
+//
+//  Requests, one per line:
+//      moves <fen>             legal moves
+//      perft <depth> <fen>     leaf count, depth capped at max_perft_depth
+//      check <fen>             whether the side to move is in check
+//      stats                   queries, queries/s, p50 and p99 latency, move cache hits
+//      format json|binary      reply format for the following requests
+//      shutdown                stops the daemon once queued requests are answered
+//
+//  Every reply carries seq, the index of its request on the connection, since
+//  requests of one connection can finish out of order on different workers.
+//  JSON replies are one line each. Binary replies are little endian frames:
+//      uint32 length of the rest of the frame
+//      uint32 seq
+//      uint8  kind, SERVER_MOVES, SERVER_PERFT, SERVER_CHECK, SERVER_STATS or SERVER_ERROR
+//      moves: uint16 count, count uint16 moves in our encoding
+//      perft: uint64 nodes
+//      check: uint8 in check
+//      stats: uint64 queries, uint64 queries/s, uint64 p50 ns, uint64 p99 ns,
+//             uint64 cache hits, uint64 cache misses, both 0 without a cache
+//      error: the message text
+//
+#include "bitboard_gen.h"
+#include "movecache.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef SERVER
+#define SERVER
+
+#define SERVER_ERROR 0
+#define SERVER_MOVES 1
+#define SERVER_PERFT 2
+#define SERVER_CHECK 3
+#define SERVER_STATS 4
+
+struct server_options{
+    std::string path;
+    int threads = 1;
+    int batch_size = 32;
+    int max_perft_depth = 5;
+    //move list cache size, 0 for none
+    size_t cache_megabytes = 0;
+};
+
+struct server_stats{
+    U64 queries = 0;
+    double seconds = 0;
+    U64 p50_ns = 0;
+    U64 p99_ns = 0;
+    move_cache_stats cache;
+};
+
+//log linear histogram, 8 buckets per power of two, recorded without locks
+class Latency_Histogram{
+public:
+    void record(U64 ns);
+    //value below which the given fraction of the samples fall, to within a bucket
+    U64 percentile(double fraction) const;
+    U64 count() const { return total.load(std::memory_order_relaxed); }
+
+private:
+    static const int num_buckets = 8 + 61 * 8;
+    std::atomic<U64> buckets[num_buckets] = {};
+    std::atomic<U64> total{0};
+};
+
+//boards built once with their zobrist keys and reused for any fen
+class Board_Pool{
+public:
+    explicit Board_Pool(int boards);
+    //a free board, a new one when all are taken
+    Bitboard_Gen * acquire();
+    void release(Bitboard_Gen * board);
+    size_t size();
+
+private:
+    std::mutex lock;
+    std::vector<std::unique_ptr<Bitboard_Gen>> boards;
+    std::vector<Bitboard_Gen *> free_boards;
+};
+
+//false for text set_board cannot load safely: bad placement, pawns on the back
+//ranks, not one king a side, or castling and en passant that do not fit the pieces.
+//the side not to move being in check is caught after loading
+bool valid_fen(const std::string & fen);
+
+class Query_Server{
+public:
+    explicit Query_Server(const server_options & options);
+    ~Query_Server();
+    //serves until a shutdown request or stop, false if the socket could not be opened
+    bool run();
+    void stop();
+    server_stats stats();
+
+private:
+    struct connection{
+        int fd;
+        std::mutex write_lock;
+        std::string input;  //bytes after the last complete line
+        uint32_t next_seq = 0;
+        bool binary = false;
+        explicit connection(int descriptor) : fd(descriptor){}
+        ~connection();
+    };
+    struct query{
+        std::shared_ptr<connection> client;
+        uint32_t seq;
+        uint8_t kind;
+        bool binary;
+        int depth;
+        std::string text;  //the fen, or the message for an error
+        std::chrono::steady_clock::time_point received;
+    };
+
+    server_options options;
+    Board_Pool pool;
+    std::unique_ptr<Move_Cache> cache;
+    Latency_Histogram latency;
+    std::chrono::steady_clock::time_point start_time;
+    std::atomic<U64> queries{0};
+    std::atomic<bool> stop_flag{false};
+
+    std::mutex queue_lock;
+    std::condition_variable queue_ready;
+    std::deque<query> pending;
+    bool draining = false;
+
+    //false once the client has closed its end or sent a line too long to be a request
+    bool read_requests(const std::shared_ptr<connection> & client);
+    void parse_request(const std::shared_ptr<connection> & client, const std::string & line);
+    void worker();
+    void execute(Bitboard_Gen & board, const query & request, std::string & out);
+};
+
+#endif
@@ -0,0 +1,665 @@
+//
+//  tablebase.cpp
+//  InvincibleSummer
+//
+
+#include "tablebase.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#if defined(_WIN32)
+    #define TB_NO_MMAP
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+//only used while building, never written to disk
+#define TB_UNKNOWN 4
+#define TB_NO_EXIT 255
+
+static const char piece_letters[] = "KQRBNP";
+static const int letter_types[] = {KING_BOARD, QUEEN_BOARD, ROOK_BOARD, BISHOP_BOARD, KNIGHT_BOARD, PAWN_BOARD};
+static const int letter_values[] = {0, 9, 5, 3, 3, 1};
+
+static int letter_order(char c){
+    const char * found = strchr(piece_letters, c);
+    return found && c ? (int) (found - piece_letters) : -1;
+}
+
+//the side with more pieces, then more material, goes first
+static bool stronger_side(const std::string & a, const std::string & b){
+    if(a.size() != b.size())
+        return a.size() > b.size();
+    int value_a = 0, value_b = 0;
+    for(char c : a)
+        value_a += letter_values[letter_order(c)];
+    for(char c : b)
+        value_b += letter_values[letter_order(c)];
+    if(value_a != value_b)
+        return value_a > value_b;
+    return a <= b;
+}
+
+//squares the white king is folded into, a1-d1-d4 without pawns and the a-d files with them
+static int king_code(int square, bool pawns){
+    int file = square & 7, rank = square >> 3;
+    if(pawns)
+        return file < 4 ? rank * 4 + file : -1;
+    static const int triangle[64] = {
+         0,  1,  2,  3, -1, -1, -1, -1,
+        -1,  4,  5,  6, -1, -1, -1, -1,
+        -1, -1,  7,  8, -1, -1, -1, -1,
+        -1, -1, -1,  9, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1,
+    };
+    return triangle[square];
+}
+
+static int king_square(int code, bool pawns){
+    if(pawns)
+        return (code / 4) * 8 + code % 4;
+    static const int squares[10] = {0, 1, 2, 3, 9, 10, 11, 18, 19, 27};
+    return squares[code];
+}
+
+//bit 2 transposes along a1-h8, bit 0 mirrors the files, bit 1 flips the ranks
+static inline int transform_square(int square, int symmetry){
+    if(symmetry & 4)
+        square = ((square & 7) << 3) | (square >> 3);
+    if(symmetry & 1)
+        square ^= 7;
+    if(symmetry & 2)
+        square ^= 56;
+    return square;
+}
+
+bool tb_layout::parse(const std::string & signature){
+    size_t split = signature.find('v');
+    if(split == std::string::npos)
+        return false;
+    std::string sides[2] = {signature.substr(0, split), signature.substr(split + 1)};
+    for(std::string & side : sides){
+        if(std::count(side.begin(), side.end(), 'K') != 1)
+            return false;
+        for(char c : side){
+            if(letter_order(c) < 0)
+                return false;
+        }
+        std::sort(side.begin(), side.end(), [](char a, char b){ return letter_order(a) < letter_order(b); });
+    }
+    if(!stronger_side(sides[0], sides[1]))
+        std::swap(sides[0], sides[1]);
+    num_pieces = (int) (sides[0].size() + sides[1].size());
+    if(num_pieces > TB_MAX_PIECES)
+        return false;
+    name = sides[0] + "v" + sides[1];
+    has_pawns = false;
+    int slot = 0;
+    for(int color = WHITE; color <= BLACK; color++){
+        for(char c : sides[color]){
+            int type = letter_types[letter_order(c)];
+            pieces[slot++] = color + (type << 1);
+            has_pawns |= type == PAWN_BOARD;
+        }
+    }
+    num_entries = (has_pawns ? 32 : 10) * 2;
+    for(int i = 1; i < num_pieces; i++)
+        num_entries *= 64;
+    return true;
+}
+
+uint64_t tb_layout::index(const int * squares, int side) const{
+    uint64_t index = king_code(squares[0], has_pawns);
+    for(int i = 1; i < num_pieces; i++)
+        index = index * 64 + squares[i];
+    return index * 2 + side;
+}
+
+void tb_layout::decode(uint64_t index, int * squares, int & side) const{
+    side = (int) (index & 1);
+    index >>= 1;
+    for(int i = num_pieces - 1; i > 0; i--){
+        squares[i] = (int) (index & 63);
+        index >>= 6;
+    }
+    squares[0] = king_square((int) index, has_pawns);
+}
+
+uint64_t tb_layout::canonical_index(Bitboard_Gen & board, bool flipped) const{
+    int squares[TB_MAX_PIECES];
+    U64 remaining[16];
+    //a flipped board is read with colors swapped and ranks mirrored
+    for(int i = 0; i < num_pieces; i++){
+        int piece = pieces[i];
+        if(i == 0 || pieces[i - 1] != piece)
+            remaining[piece] = board.bitboards[(piece & 1) ^ flipped] & board.bitboards[piece >> 1];
+        squares[i] = board.pop_lsb(&remaining[piece]) ^ (flipped ? 56 : 0);
+    }
+    uint64_t best = UINT64_MAX;
+    int num_symmetries = has_pawns ? 2 : 8;
+    for(int symmetry = 0; symmetry < num_symmetries; symmetry++){
+        int transformed[TB_MAX_PIECES];
+        transformed[0] = transform_square(squares[0], symmetry);
+        if(king_code(transformed[0], has_pawns) < 0)
+            continue;
+        for(int i = 1; i < num_pieces; i++)
+            transformed[i] = transform_square(squares[i], symmetry);
+        //identical pieces sit next to each other, keep them in square order
+        for(int pass = 0; pass < 2; pass++){
+            for(int i = 2; i < num_pieces; i++){
+                if(pieces[i] == pieces[i - 1] && transformed[i] < transformed[i - 1])
+                    std::swap(transformed[i], transformed[i - 1]);
+            }
+        }
+        best = std::min(best, index(transformed, board.current_side ^ flipped));
+    }
+    return best;
+}
+
+std::string material_signature(Bitboard_Gen & board, bool & flipped){
+    std::string sides[2];
+    for(int color = WHITE; color <= BLACK; color++){
+        for(int letter = 0; letter < 6; letter++){
+            U64 pieces = board.bitboards[color] & board.bitboards[letter_types[letter]];
+            for(; pieces; pieces &= pieces - 1)
+                sides[color] += piece_letters[letter];
+        }
+    }
+    flipped = sides[0] != sides[1] && !stronger_side(sides[0], sides[1]);
+    return flipped ? sides[1] + "v" + sides[0] : sides[0] + "v" + sides[1];
+}
+
+//the base 3 material digits of one side of a signature, -1 if a kind is there 3 times
+static int side_material(const std::string & side){
+    int digits[6] = {0, 0, 0, 0, 0, 0};
+    for(char c : side)
+        digits[letter_order(c)]++;
+    int key = 0;
+    for(int letter = 5; letter >= 1; letter--){
+        if(digits[letter] > 2)
+            return -1;
+        key = key * 3 + digits[letter];
+    }
+    return key;
+}
+
+int material_key(Bitboard_Gen & board){
+    int sides[2] = {0, 0};
+    for(int color = WHITE; color <= BLACK; color++){
+        for(int letter = 5; letter >= 1; letter--){
+            int count = board.popcount(board.bitboards[color] & board.bitboards[letter_types[letter]]);
+            if(count > 2)
+                return -1;
+            sides[color] = sides[color] * 3 + count;
+        }
+    }
+    return sides[WHITE] * TB_SIDE_MATERIAL + sides[BLACK];
+}
+
+static bool setup_board(Bitboard_Gen & board, const tb_layout & layout, const int * squares, int side){
+    U64 used = 0;
+    for(int i = 0; i < layout.num_pieces; i++){
+        if(used & Bitboard_Gen::occupy_square[squares[i]])
+            return false;
+        used |= Bitboard_Gen::occupy_square[squares[i]];
+        if((layout.pieces[i] >> 1) == PAWN_BOARD && (squares[i] < 8 || squares[i] >= 56))
+            return false;
+    }
+    board.clear_board();
+    for(int i = 0; i < layout.num_pieces; i++)
+        board.add_piece(layout.pieces[i], squares[i]);
+    board.zobrist_hash = 0;
+    board.current_side = side;
+    board.ply = 0;
+    board.game_history[0] = game_state(0, 0, 0);
+    return true;
+}
+
+//hands out blocks of indices to the threads until the range is used up
+static void parallel_for(int threads, uint64_t count, const std::function<void(uint64_t, uint64_t)> & body){
+    const uint64_t block = 4096;
+    std::atomic<uint64_t> next{0};
+    auto worker = [&](){
+        for(uint64_t begin = next.fetch_add(block); begin < count; begin = next.fetch_add(block))
+            body(begin, std::min(begin + block, count));
+    };
+    std::vector<std::thread> pool;
+    for(int i = 1; i < threads; i++)
+        pool.emplace_back(worker);
+    worker();
+    for(auto & thread : pool)
+        thread.join();
+}
+
+static std::set<std::string> child_signatures(const tb_layout & layout){
+    std::string sides[2] = {layout.name.substr(0, layout.name.find('v')), layout.name.substr(layout.name.find('v') + 1)};
+    std::set<std::string> children;
+    for(int side = 0; side < 2; side++){
+        std::string own = sides[side], other = sides[!side];
+        for(size_t i = 1; i < own.size(); i++){
+            //own piece captured
+            children.insert(own.substr(0, i) + own.substr(i + 1) + "v" + other);
+            if(own[i] != 'P')
+                continue;
+            for(char promo : std::string("QRBN")){
+                std::string promoted = own;
+                promoted[i] = promo;
+                children.insert(promoted + "v" + other);
+                //promotion with capture
+                for(size_t j = 1; j < other.size(); j++)
+                    children.insert(promoted + "v" + other.substr(0, j) + other.substr(j + 1));
+            }
+        }
+    }
+    std::set<std::string> names;
+    for(const std::string & child : children){
+        tb_layout child_layout;
+        if(child_layout.parse(child))
+            names.insert(child_layout.name);
+    }
+    return names;
+}
+
+Tablebase::~Tablebase(){
+    for(auto & entry : tables){
+#if defined(TB_NO_MMAP)
+        delete[] entry.second->base;
+#else
+        munmap((void *) entry.second->base, entry.second->size);
+#endif
+    }
+}
+
+int Tablebase::load_directory(const std::string & directory){
+    int loaded = 0;
+    std::error_code error;
+    for(const auto & file : std::filesystem::directory_iterator(directory, error)){
+        if(file.path().extension() == TB_FILE_EXTENSION && load(file.path().string()))
+            loaded++;
+    }
+    return loaded;
+}
+
+bool Tablebase::load(const std::string & path){
+    std::unique_ptr<mapped_table> table(new mapped_table());
+#if defined(TB_NO_MMAP)
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file)
+        return false;
+    table->size = (size_t) file.tellg();
+    uint8_t * buffer = new uint8_t[table->size];
+    file.seekg(0);
+    file.read((char *) buffer, table->size);
+    table->base = buffer;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    struct stat info;
+    if(fstat(fd, &info) || info.st_size < (off_t) sizeof(tb_header)){
+        close(fd);
+        return false;
+    }
+    table->size = (size_t) info.st_size;
+    void * base = mmap(nullptr, table->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED)
+        return false;
+    table->base = (const uint8_t *) base;
+#endif
+    //from here on the destructor of a rejected table would leak, so check then insert
+    tb_header header;
+    memcpy(&header, table->base, sizeof(header));
+    header.signature[15] = 0;
+    bool valid = header.magic == TB_FILE_MAGIC && header.version == TB_FILE_VERSION
+        && table->layout.parse(header.signature) && table->layout.name == header.signature
+        && table->layout.num_entries == header.num_entries
+        && table->size >= sizeof(header) + (header.num_entries + 3) / 4 + header.num_entries
+        && !tables.count(table->layout.name);
+    if(!valid){
+#if defined(TB_NO_MMAP)
+        delete[] table->base;
+#else
+        munmap((void *) table->base, table->size);
+#endif
+        return false;
+    }
+    table->wdl = table->base + sizeof(header);
+    table->dtm = table->wdl + (header.num_entries + 3) / 4;
+    //white holding the first side, and the flipped board unless both sides are the same
+    const std::string & name = table->layout.name;
+    int first = side_material(name.substr(0, name.find('v'))), second = side_material(name.substr(name.find('v') + 1));
+    if(by_material.empty())
+        by_material.resize(TB_MATERIAL_KEYS);
+    by_material[first * TB_SIDE_MATERIAL + second] = {table.get(), false};
+    if(first != second)
+        by_material[second * TB_SIDE_MATERIAL + first] = {table.get(), true};
+    tables[name] = std::move(table);
+    return true;
+}
+
+bool Tablebase::probe(Bitboard_Gen & board, int & wdl, int & dtm){
+    U64 occupied = board.bitboards[WHITE] | board.bitboards[BLACK];
+    int count = board.popcount(occupied);
+    if(count > TB_MAX_PIECES)
+        return false;
+    const game_state & state = board.game_history[board.ply];
+    if(state.castling_rights)
+        return false;
+    if(Bitboard_Gen::ep_target_lookup[state.ep_target] & board.bitboards[board.current_side] & board.bitboards[PAWN_BOARD])
+        return false;
+    if(count == 2){
+        wdl = TB_DRAW;
+        dtm = 0;
+        return true;
+    }
+    int key = material_key(board);
+    if(key < 0 || by_material.empty() || !by_material[key].table)
+        return false;
+    const mapped_table & table = *by_material[key].table;
+    uint64_t index = table.layout.canonical_index(board, by_material[key].flipped);
+    wdl = (table.wdl[index >> 2] >> ((index & 3) * 2)) & 3;
+    dtm = table.dtm[index];
+    return wdl != TB_INVALID;
+}
+
+bool Tablebase::build(const std::string & signature, const std::string & directory, int threads){
+    tb_layout layout;
+    if(!layout.parse(signature))
+        return false;
+    if(layout.num_pieces <= 2 || tables.count(layout.name))
+        return true;
+    //every table a capture or promotion can convert into comes first
+    for(const std::string & child : child_signatures(layout)){
+        if(!build(child, directory, threads))
+            return false;
+    }
+    std::string path = directory + "/" + layout.name + TB_FILE_EXTENSION;
+    if(load(path))
+        return true;
+    return generate(layout, path, threads) && load(path);
+}
+
+//a double push the opponent can take en passant does not lead to the table entry
+//of the same placement, which has no en passant rights. The child is that entry
+//with one more reply, the capture, whose result comes from a finished table
+struct tb_ep_edge{
+    uint64_t position;
+    uint64_t child;
+    bool counted;       //false when the capture is the only reply, then it is an exit
+    uint8_t wdl;        //result of the child if the capture were its only reply,
+    uint8_t dtm;        //from the child's side to move
+    uint8_t win_level;  //TB_NO_EXIT, or when the child turned out lost for the opponent
+};
+
+//the better of two results for the side to move
+static void keep_best(int & wdl, int & dtm, int other_wdl, int other_dtm){
+    static const int rank[3] = {1, 2, 0};  //draw, win, loss
+    if(rank[other_wdl] > rank[wdl] || (other_wdl == wdl && wdl == TB_WIN && other_dtm < dtm) || (other_wdl == wdl && wdl == TB_LOSS && other_dtm > dtm)){
+        wdl = other_wdl;
+        dtm = other_dtm;
+    }
+}
+
+//retrograde analysis. Every entry starts with the number of distinct positions
+//it can move to inside the table, and with the best result reachable through a
+//capture or promotion into an already finished table. Then, one distance at a
+//time, every position decided at that distance walks its un-moves: predecessors
+//of a loss are wins one ply later, and predecessors of a win count down, losing
+//once every move they have leads to a win for the opponent. Double pushes that
+//allow en passant are tb_ep_edges and combine the child's result with the capture
+bool Tablebase::generate(const tb_layout & layout, const std::string & path, int threads){
+    uint64_t n = layout.num_entries;
+    //result << 8 | plies to mate, in one word so threads never see half an update
+    std::unique_ptr<std::atomic<uint16_t>[]> values(new std::atomic<uint16_t>[n]);
+    std::unique_ptr<std::atomic<uint8_t>[]> counters(new std::atomic<uint8_t>[n]);
+    std::vector<uint8_t> exit_win(n, TB_NO_EXIT), exit_loss(n, 0), draw_exit(n, 0);
+    std::atomic<bool> failed{false};
+    std::atomic<int> max_level{0};
+    auto raise_level = [&](int level){
+        int current = max_level.load();
+        while(level > current && !max_level.compare_exchange_weak(current, level));
+    };
+    std::vector<tb_ep_edge> ep_edges;
+    std::mutex ep_lock;
+    auto add_exit = [&](uint64_t i, int child_wdl, int child_dtm){
+        if(child_wdl == TB_LOSS)
+            exit_win[i] = (uint8_t) std::min<int>(exit_win[i], child_dtm + 1);
+        else if(child_wdl == TB_WIN)
+            exit_loss[i] = (uint8_t) std::max<int>(exit_loss[i], child_dtm + 1);
+        else
+            draw_exit[i] = 1;
+    };
+
+    parallel_for(threads, n, [&](uint64_t begin, uint64_t end){
+        Bitboard_Gen board;
+        board.init_zobrist_keys();
+        for(uint64_t i = begin; i < end; i++){
+            int squares[TB_MAX_PIECES], side;
+            layout.decode(i, squares, side);
+            //overlapping pieces, symmetric duplicates and the side not to move in check
+            if(!setup_board(board, layout, squares, side) || layout.canonical_index(board) != i || board.is_move_legal()){
+                values[i].store(TB_INVALID << 8, std::memory_order_relaxed);
+                counters[i].store(0, std::memory_order_relaxed);
+                continue;
+            }
+            bool in_check = board.position_in_check();
+            uint16_t move_list[256];
+            uint64_t children[256];
+            int num_moves = board.generate_moves(move_list);
+            int num_children = 0, legal = 0, num_edges = 0;
+            for(int m = 0; m < num_moves; m++){
+                uint16_t move = move_list[m];
+                board.make_move(move);
+                if(!board.is_move_legal()){
+                    legal++;
+                    int flag = move & 0x0f;
+                    int ep_wdl = TB_INVALID, ep_dtm = 0, other_replies = 0;
+                    if(flag == DOUBLE_PAWN_PUSH_FLAG){
+                        //the opponent's replies, keeping the best en passant capture
+                        uint16_t reply_list[256];
+                        int num_replies = board.generate_moves(reply_list);
+                        for(int r = 0; r < num_replies; r++){
+                            board.make_move(reply_list[r]);
+                            if(!board.is_move_legal()){
+                                int child_wdl, child_dtm;
+                                if((reply_list[r] & 0x0f) != EN_PASSANT_FLAG){
+                                    other_replies++;
+                                }else if(!probe(board, child_wdl, child_dtm)){
+                                    failed.store(true);
+                                }else{
+                                    int wdl = child_wdl == TB_WIN ? TB_LOSS : child_wdl == TB_LOSS ? TB_WIN : TB_DRAW;
+                                    int dtm = wdl == TB_DRAW ? 0 : child_dtm + 1;
+                                    if(ep_wdl == TB_INVALID){
+                                        ep_wdl = wdl;
+                                        ep_dtm = dtm;
+                                    }else{
+                                        keep_best(ep_wdl, ep_dtm, wdl, dtm);
+                                    }
+                                }
+                            }
+                            board.unmake_move(reply_list[r]);
+                        }
+                    }
+                    if((flag & CAPTURE_FLAG) || (flag & 8)){
+                        int child_wdl, child_dtm;
+                        if(!probe(board, child_wdl, child_dtm))
+                            failed.store(true);
+                        else
+                            add_exit(i, child_wdl, child_dtm);
+                    }else if(ep_wdl != TB_INVALID){
+                        tb_ep_edge edge{i, layout.canonical_index(board), other_replies > 0, (uint8_t) ep_wdl, (uint8_t) ep_dtm, TB_NO_EXIT};
+                        if(!edge.counted)
+                            add_exit(i, ep_wdl, ep_dtm);
+                        else if(ep_wdl == TB_WIN)
+                            raise_level(ep_dtm);
+                        num_edges += edge.counted;
+                        std::lock_guard<std::mutex> guard(ep_lock);
+                        ep_edges.push_back(edge);
+                    }else{
+                        children[num_children++] = layout.canonical_index(board);
+                    }
+                }
+                board.unmake_move(move);
+            }
+            std::sort(children, children + num_children);
+            num_children = (int) (std::unique(children, children + num_children) - children);
+            //with four pieces both sides have one pawn, so there is at most one edge
+            num_children += num_edges;
+            counters[i].store((uint8_t) num_children, std::memory_order_relaxed);
+
+            uint16_t value = TB_UNKNOWN << 8;
+            if(!legal)
+                value = in_check ? TB_LOSS << 8 : TB_DRAW << 8;
+            else if(!num_children && exit_win[i] != TB_NO_EXIT)
+                value = (TB_WIN << 8) | exit_win[i];
+            else if(!num_children && draw_exit[i])
+                value = TB_DRAW << 8;
+            else if(!num_children)
+                value = (TB_LOSS << 8) | exit_loss[i];
+            values[i].store(value, std::memory_order_relaxed);
+            if((value >> 8) == TB_WIN || (value >> 8) == TB_LOSS)
+                raise_level(value & 0xff);
+            if(exit_win[i] != TB_NO_EXIT)
+                raise_level(exit_win[i]);
+        }
+    });
+    if(failed.load())
+        return false;
+    std::sort(ep_edges.begin(), ep_edges.end(), [](const tb_ep_edge & a, const tb_ep_edge & b){ return a.position < b.position; });
+    std::unique_ptr<std::atomic<bool>[]> edge_resolved(new std::atomic<bool>[ep_edges.size()]);
+    for(size_t e = 0; e < ep_edges.size(); e++)
+        edge_resolved[e].store(false, std::memory_order_relaxed);
+    auto find_edge = [&](uint64_t position, uint64_t child) -> int{
+        auto found = std::lower_bound(ep_edges.begin(), ep_edges.end(), position, [](const tb_ep_edge & edge, uint64_t key){ return edge.position < key; });
+        return found != ep_edges.end() && found->position == position && found->child == child ? (int) (found - ep_edges.begin()) : -1;
+    };
+    //one more move of previous is known to lose at this level
+    auto lose_edge = [&](uint64_t previous, int level){
+        uint16_t expected = TB_UNKNOWN << 8;
+        if(counters[previous].fetch_sub(1) == 1 && exit_win[previous] == TB_NO_EXIT && !draw_exit[previous]){
+            int distance = std::max<int>(level + 1, exit_loss[previous]);
+            if(values[previous].compare_exchange_strong(expected, (uint16_t) ((TB_LOSS << 8) | distance)))
+                raise_level(distance);
+        }
+    };
+
+    for(int level = 0; level < 254 && level <= max_level.load(); level++){
+        //wins through a capture or promotion take effect at their own distance
+        parallel_for(threads, n, [&](uint64_t begin, uint64_t end){
+            for(uint64_t i = begin; i < end; i++){
+                uint16_t expected = TB_UNKNOWN << 8;
+                if(exit_win[i] == level)
+                    values[i].compare_exchange_strong(expected, (uint16_t) ((TB_WIN << 8) | level));
+            }
+        });
+        //and so do en passant edges: a win once the child is lost either way, a
+        //loss as soon as the capture wins unless the child won for the opponent sooner
+        for(size_t e = 0; e < ep_edges.size(); e++){
+            const tb_ep_edge & edge = ep_edges[e];
+            uint16_t expected = TB_UNKNOWN << 8;
+            if(edge.win_level == level)
+                values[edge.position].compare_exchange_strong(expected, (uint16_t) ((TB_WIN << 8) | level));
+            else if(edge.counted && edge.wdl == TB_WIN && edge.dtm == level && values[edge.position].load() == expected
+                    && !edge_resolved[e].exchange(true))
+                lose_edge(edge.position, level);
+        }
+        parallel_for(threads, n, [&](uint64_t begin, uint64_t end){
+            Bitboard_Gen board;
+            board.init_zobrist_keys();
+            for(uint64_t i = begin; i < end; i++){
+                uint16_t value = values[i].load(std::memory_order_relaxed);
+                int result = value >> 8;
+                if((value & 0xff) != level || (result != TB_WIN && result != TB_LOSS))
+                    continue;
+                int squares[TB_MAX_PIECES], side;
+                layout.decode(i, squares, side);
+                setup_board(board, layout, squares, side);
+
+                uint16_t unmove_list[256];
+                uint64_t predecessors[256];
+                int num_unmoves = board.generate_unmoves(unmove_list);
+                for(int u = 0; u < num_unmoves; u++){
+                    int source = (unmove_list[u] >> 10) & 0x3f;
+                    int dest = (unmove_list[u] >> 4) & 0x3f;
+                    board.move_piece(source, dest);
+                    board.current_side = !board.current_side;
+                    predecessors[u] = layout.canonical_index(board);
+                    board.move_piece(dest, source);
+                    board.current_side = !board.current_side;
+                }
+                std::sort(predecessors, predecessors + num_unmoves);
+                int num_predecessors = (int) (std::unique(predecessors, predecessors + num_unmoves) - predecessors);
+
+                for(int p = 0; p < num_predecessors; p++){
+                    uint64_t previous = predecessors[p];
+                    uint16_t expected = TB_UNKNOWN << 8;
+                    if(values[previous].load(std::memory_order_relaxed) != expected)
+                        continue;
+                    int e = ep_edges.empty() ? -1 : find_edge(previous, i);
+                    if(e >= 0){
+                        tb_ep_edge & edge = ep_edges[e];
+                        if(!edge.counted)
+                            continue;
+                        //lost for the opponent only if the capture loses too, and then as late as the later of the two
+                        if(result == TB_LOSS && edge.wdl == TB_LOSS){
+                            int distance = std::max<int>(level, edge.dtm) + 1;
+                            if(distance == level + 1){
+                                if(values[previous].compare_exchange_strong(expected, (uint16_t) ((TB_WIN << 8) | distance)))
+                                    raise_level(distance);
+                            }else{
+                                edge.win_level = (uint8_t) distance;
+                                raise_level(distance);
+                            }
+                        }else if(result == TB_WIN && !edge_resolved[e].exchange(true)){
+                            lose_edge(previous, level);
+                        }
+                        continue;
+                    }
+                    if(result == TB_LOSS){
+                        if(values[previous].compare_exchange_strong(expected, (uint16_t) ((TB_WIN << 8) | (level + 1))))
+                            raise_level(level + 1);
+                    }else{
+                        lose_edge(previous, level);
+                    }
+                }
+            }
+        });
+    }
+
+    tb_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = TB_FILE_MAGIC;
+    header.version = TB_FILE_VERSION;
+    strncpy(header.signature, layout.name.c_str(), sizeof(header.signature) - 1);
+    header.num_entries = n;
+    std::vector<uint8_t> wdl((n + 3) / 4, 0), dtm(n, 0);
+    for(uint64_t i = 0; i < n; i++){
+        uint16_t value = values[i].load(std::memory_order_relaxed);
+        int result = value >> 8;
+        //nothing could be forced either way
+        if(result == TB_UNKNOWN)
+            result = TB_DRAW;
+        wdl[i >> 2] |= result << ((i & 3) * 2);
+        if(result == TB_WIN || result == TB_LOSS)
+            dtm[i] = value & 0xff;
+    }
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char *) &header, sizeof(header));
+    file.write((const char *) wdl.data(), wdl.size());
+    file.write((const char *) dtm.data(), dtm.size());
+    return (bool) file;
+}
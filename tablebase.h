@@ -0,0 +1,102 @@
+//
+//  tablebase.h
+//  InvincibleSummer
+//
+//  Retrograde endgame tablebases for up to 4 pieces. Tables are built from the
+//  move and un-move generators, written bit-packed and symmetry reduced to
+//  disk, and probed through a memory map with a single index computation.
+//
+#include "bitboard_gen.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef TABLEBASE
+#define TABLEBASE
+
+#define TB_MAX_PIECES 4
+
+//results from the side to move's point of view
+#define TB_DRAW 0
+#define TB_WIN 1
+#define TB_LOSS 2
+#define TB_INVALID 3
+
+//"ISTB" read as a little endian uint32
+#define TB_FILE_MAGIC 0x42545349
+//2 since double pushes are scored with the en passant reply
+#define TB_FILE_VERSION 2
+#define TB_FILE_EXTENSION ".istb"
+
+//a side's queens, rooks, bishops, knights and pawns as base 3 digits, white's
+//count then black's. with 4 pieces at most no side has more than 2 of a kind
+#define TB_SIDE_MATERIAL 243
+#define TB_MATERIAL_KEYS (TB_SIDE_MATERIAL * TB_SIDE_MATERIAL)
+
+struct tb_header{
+    uint32_t magic;
+    uint32_t version;
+    char signature[16];
+    uint64_t num_entries;
+};
+
+//maps positions of one material signature to table indices. The white king
+//is folded into the a1-d1-d4 triangle (a-d files when there are pawns) and the
+//smallest index over the remaining symmetries is used, so every symmetric
+//position shares a single entry
+struct tb_layout{
+    std::string name;            //canonical signature, e.g. "KQvKR"
+    int num_pieces = 0;
+    int pieces[TB_MAX_PIECES];   //mailbox piece codes, white king first
+    bool has_pawns = false;
+    uint64_t num_entries = 0;
+
+    //accepts any order of the two sides, e.g. "KvKQ" lays out as "KQvK"
+    bool parse(const std::string & signature);
+    uint64_t index(const int * squares, int side) const;
+    void decode(uint64_t index, int * squares, int & side) const;
+    //board must hold exactly this material, with black as the first side if flipped
+    uint64_t canonical_index(Bitboard_Gen & board, bool flipped = false) const;
+};
+
+//canonical signature of a board, flipped is set when black holds the first side
+std::string material_signature(Bitboard_Gen & board, bool & flipped);
+//index of the board's material below TB_MATERIAL_KEYS, -1 for more than 2 of a kind
+int material_key(Bitboard_Gen & board);
+
+class Tablebase{
+public:
+    ~Tablebase();
+
+    //maps every table file found in the directory, returns how many were loaded
+    int load_directory(const std::string & directory);
+    bool load(const std::string & path);
+
+    //builds the table and everything it converts into, skipping tables already
+    //loaded, writes each one to directory and maps it
+    bool build(const std::string & signature, const std::string & directory, int threads);
+
+    //false if the material has no table or the position has castling or en passant rights
+    bool probe(Bitboard_Gen & board, int & wdl, int & dtm);
+
+private:
+    struct mapped_table{
+        tb_layout layout;
+        const uint8_t * base = nullptr;
+        size_t size = 0;
+        const uint8_t * wdl = nullptr; //2 bits per entry
+        const uint8_t * dtm = nullptr; //plies to mate, 1 byte per entry
+    };
+    std::map<std::string, std::unique_ptr<mapped_table>> tables;
+    //the tables again by material_key, so a probe allocates nothing
+    struct material_slot{
+        const mapped_table * table = nullptr;
+        bool flipped = false;
+    };
+    std::vector<material_slot> by_material;
+
+    bool generate(const tb_layout & layout, const std::string & path, int threads);
+};
+
+#endif
@@ -0,0 +1,114 @@
+//
+//  transposition.cpp
+//  InvincibleSummer
+//
+
+#include "transposition.h"
+#include <new>
+
+//data layout: move 16 | score 16 | eval 16 | depth 8 | bound 2 | generation 6
+uint64_t Transposition_Table::pack(const tt_data & data, uint8_t generation){
+    return (uint64_t) data.move
+        | ((uint64_t) (uint16_t) data.score << 16)
+        | ((uint64_t) (uint16_t) data.eval << 32)
+        | ((uint64_t) (uint8_t) data.depth << 48)
+        | ((uint64_t) (data.bound & 3) << 56)
+        | ((uint64_t) (generation & 0x3f) << 58);
+}
+
+tt_data Transposition_Table::unpack(uint64_t packed){
+    tt_data data;
+    data.move = (uint16_t) packed;
+    data.score = (int16_t) (packed >> 16);
+    data.eval = (int16_t) (packed >> 32);
+    data.depth = (int8_t) (packed >> 48);
+    data.bound = (packed >> 56) & 3;
+    return data;
+}
+
+Transposition_Table::Transposition_Table(size_t megabytes){
+    resize(megabytes);
+}
+
+//rounds down to a power of two number of buckets so indexing is a mask
+void Transposition_Table::resize(size_t megabytes, int threads){
+    size_t num_buckets = 1;
+    while(num_buckets * 2 * sizeof(tt_bucket) <= megabytes * 1024 * 1024)
+        num_buckets *= 2;
+    //drop the old table first so both are never mapped at once
+    memory.release();
+    if(!memory.allocate(num_buckets * sizeof(tt_bucket)))
+        throw std::bad_alloc();
+    buckets = memory.as<tt_bucket>();
+    bucket_mask = num_buckets - 1;
+    size_megabytes = megabytes;
+    clear(threads);
+}
+
+//the entries are plain atomics of zero, so zeroing the bytes is the same as storing 0
+void Transposition_Table::clear(int threads){
+    memory.first_touch(threads);
+    generation = 0;
+}
+
+void Transposition_Table::new_search(){
+    generation = (generation + 1) & 0x3f;
+}
+
+bool Transposition_Table::probe(uint64_t key, tt_data & out) const{
+    const tt_bucket & bucket = buckets[key & bucket_mask];
+    for(int i = 0; i < TT_BUCKET_SIZE; i++){
+        uint64_t data = bucket.entries[i].data.load(std::memory_order_relaxed);
+        uint64_t stored_key = bucket.entries[i].key.load(std::memory_order_relaxed);
+        if((stored_key ^ data) == key && data){
+            out = unpack(data);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Transposition_Table::store(uint64_t key, uint16_t move, int score, int eval, int depth, int bound){
+    tt_bucket & bucket = buckets[key & bucket_mask];
+    tt_entry * replace = &bucket.entries[0];
+    int worst = 1 << 30;
+    for(int i = 0; i < TT_BUCKET_SIZE; i++){
+        tt_entry & entry = bucket.entries[i];
+        uint64_t data = entry.data.load(std::memory_order_relaxed);
+        uint64_t stored_key = entry.key.load(std::memory_order_relaxed);
+        if((stored_key ^ data) == key){
+            tt_data old = unpack(data);
+            //keep a deeper entry for the same position unless this one is exact
+            if(bound != TT_BOUND_EXACT && depth < old.depth - 2 && ((data >> 58) & 0x3f) == generation)
+                return;
+            if(!move)
+                move = old.move;
+            replace = &entry;
+            break;
+        }
+        //prefer replacing shallow entries and ones left over from older searches
+        int age = (generation - (int) ((data >> 58) & 0x3f)) & 0x3f;
+        int value = data ? unpack(data).depth - 8 * age : -(1 << 20);
+        if(value < worst){
+            worst = value;
+            replace = &entry;
+        }
+    }
+    tt_data data{move, (int16_t) score, (int16_t) eval, (int8_t) depth, (uint8_t) bound};
+    uint64_t packed = pack(data, generation);
+    replace->key.store(key ^ packed, std::memory_order_relaxed);
+    replace->data.store(packed, std::memory_order_relaxed);
+}
+
+int Transposition_Table::hashfull() const{
+    int used = 0;
+    uint64_t samples = bucket_mask + 1 < 250 ? bucket_mask + 1 : 250;
+    for(uint64_t i = 0; i < samples; i++){
+        for(int j = 0; j < TT_BUCKET_SIZE; j++){
+            uint64_t data = buckets[i].entries[j].data.load(std::memory_order_relaxed);
+            if(data && ((data >> 58) & 0x3f) == generation)
+                used++;
+        }
+    }
+    return (int) (used * 1000 / (samples * TT_BUCKET_SIZE));
+}
@@ -0,0 +1,69 @@
+//
+//  transposition.h
+//  InvincibleSummer
+//
+//  Lockless transposition table shared by every search thread.
+//
+#include "large_pages.h"
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+#ifndef TRANSPOSITION
+#define TRANSPOSITION
+
+#define TT_BOUND_NONE 0
+#define TT_BOUND_UPPER 1
+#define TT_BOUND_LOWER 2
+#define TT_BOUND_EXACT 3
+
+#define TT_BUCKET_SIZE 4
+
+struct tt_data{
+    uint16_t move;
+    int16_t score;
+    int16_t eval;
+    int8_t depth;
+    uint8_t bound;
+};
+
+//the key is stored xored with the data, so a write torn by another thread
+//fails the key check on probe instead of handing back a mixed up entry
+struct tt_entry{
+    std::atomic<uint64_t> key;
+    std::atomic<uint64_t> data;
+};
+
+//one bucket per cache line
+struct alignas(64) tt_bucket{
+    tt_entry entries[TT_BUCKET_SIZE];
+};
+
+class Transposition_Table{
+public:
+    Transposition_Table(size_t megabytes = 16);
+    //threads share out the first touch of the new table, see large_pages.h
+    void resize(size_t megabytes, int threads = 1);
+    void clear(int threads = 1);
+    void new_search();
+
+    bool probe(uint64_t key, tt_data & out) const;
+    void store(uint64_t key, uint16_t move, int score, int eval, int depth, int bound);
+    //permill of the first thousand entries written during this search, for uci
+    int hashfull() const;
+    size_t megabytes() const { return size_megabytes; }
+    //what the allocation got, for info output
+    const char * page_kind_name() const { return memory.page_kind_name(); }
+
+private:
+    Large_Buffer memory;
+    tt_bucket * buckets = nullptr;
+    size_t size_megabytes = 0;
+    uint64_t bucket_mask = 0;
+    uint8_t generation = 0;
+
+    static uint64_t pack(const tt_data & data, uint8_t generation);
+    static tt_data unpack(uint64_t packed);
+};
+
+#endif
@@ -0,0 +1,622 @@
+//
+//  uci.cpp
+//  InvincibleSummer
+//
+
+#include "uci.h"
+#include "benchmark.h"
+#include "perft.h"
+#include "dedup.h"
+#include "selfplay.h"
+#include "sampler.h"
+#include "mcts.h"
+#include "dfpn.h"
+#include "server.h"
+#include "notation.h"
+#include "large_pages.h"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <new>
+
+static std::mutex output_mutex;
+
+void uci_send(const std::string & line){
+    std::lock_guard<std::mutex> lock(output_mutex);
+    std::cout << line << '\n' << std::flush;
+}
+
+std::string move_to_uci(uint16_t move){
+    char text[MOVE_TEXT_SIZE];
+    return std::string(text, to_uci(move, text));
+}
+
+uint16_t parse_uci_move(Bitboard_Gen & board, const std::string & text){
+    return from_uci(board, text.c_str(), (int) text.size());
+}
+
+static std::string score_to_uci(int score){
+    if(score >= MATE_BOUND)
+        return "mate " + std::to_string((MATE_SCORE - score + 1) / 2);
+    if(score <= -MATE_BOUND)
+        return "mate " + std::to_string(-(MATE_SCORE + score) / 2);
+    return "cp " + std::to_string(score);
+}
+
+//spin option value clamped to the advertised range, false if it is not a number
+static bool parse_spin(const std::string & value, long min, long max, int & out){
+    char * end = nullptr;
+    long number = std::strtol(value.c_str(), &end, 10);
+    if(value.empty() || *end)
+        return false;
+    out = (int) std::min(std::max(number, min), max);
+    return true;
+}
+
+UCI::UCI() : board(UCI_START_FEN){
+    searcher.on_iteration = [](const search_info & info){
+        std::string line = "info depth " + std::to_string(info.depth) + " score " + score_to_uci(info.score)
+            + " nodes " + std::to_string(info.nodes) + " nps " + std::to_string(info.nps)
+            + " hashfull " + std::to_string(info.hashfull) + " time " + std::to_string(info.time) + " pv";
+        for(uint16_t move : info.pv)
+            line += " " + move_to_uci(move);
+        uci_send(line);
+    };
+}
+
+UCI::~UCI(){
+    searcher.stop();
+    perft_stop.store(true);
+    wait_for_worker();
+}
+
+void UCI::loop(std::istream & in){
+    std::string line;
+    while(std::getline(in, line)){
+        if(!execute(line))
+            return;
+    }
+    wait_for_worker();
+}
+
+bool UCI::execute(const std::string & line){
+    std::istringstream command(line);
+    std::string token;
+    command >> token;
+    if(token == "uci"){
+        uci_send("id name InvincibleSummer");
+        uci_send("id author Harry Chiu");
+        uci_send("option name Hash type spin default 16 min 1 max 65536");
+        uci_send("option name Threads type spin default 1 min 1 max 256");
+        uci_send("option name LargePages type check default true");
+        uci_send("option name Ponder type check default false");
+        uci_send("option name EvalFile type string default <empty>");
+        uci_send("option name TablebasePath type string default <empty>");
+        uci_send("option name OwnBook type check default false");
+        uci_send("option name BookFile type string default <empty>");
+        uci_send("option name Clear Hash type button");
+        uci_send("uciok");
+    }else if(token == "isready"){
+        uci_send("readyok");
+    }else if(token == "ucinewgame"){
+        wait_for_worker();
+        searcher.clear();
+    }else if(token == "position"){
+        wait_for_worker();
+        position(command);
+    }else if(token == "go"){
+        wait_for_worker();
+        go(command);
+    }else if(token == "stop"){
+        searcher.stop();
+        perft_stop.store(true);
+    }else if(token == "ponderhit"){
+        searcher.ponderhit();
+    }else if(token == "setoption"){
+        wait_for_worker();
+        setoption(command);
+    }else if(token == "bench"){
+        wait_for_worker();
+        //bench [perft] [depth] [counters], bench dedup [million positions] [megabytes] [threads]
+        //bench mate [nodes per position] [megabytes], bench notation [rounds]
+        //bench largepages [megabytes] [million probes] [depth], bench movecache [megabytes] [million queries]
+        //bench tablebase [directory] [threads] or bench polyglot [rounds]
+        bool perft = false, counters = false;
+        int depth = 0;
+        while(command >> token){
+            if(token == "dedup"){
+                double millions = 4;
+                size_t megabytes = 16;
+                int threads = searcher.get_threads();
+                command >> millions >> megabytes >> threads;
+                dedup_benchmark((U64) (std::max(millions, 0.001) * 1e6), megabytes, std::max(1, threads));
+                return true;
+            }
+            if(token == "notation"){
+                int rounds = 200;
+                command >> rounds;
+                notation_benchmark(std::max(1, rounds));
+                return true;
+            }
+            if(token == "largepages"){
+                size_t megabytes = 1024;
+                double millions = 20;
+                int search_depth = 8;
+                command >> megabytes >> millions >> search_depth;
+                large_pages_benchmark(std::max<size_t>(1, megabytes), (U64) (std::max(millions, 0.001) * 1e6), std::max(1, search_depth));
+                return true;
+            }
+            if(token == "tablebase"){
+                std::string directory = ".";
+                int threads = searcher.get_threads();
+                command >> directory >> threads;
+                tablebase_benchmark(directory, std::max(1, threads));
+                return true;
+            }
+            if(token == "polyglot"){
+                int rounds = 100000;
+                command >> rounds;
+                polyglot_benchmark(std::max(1, rounds));
+                return true;
+            }
+            if(token == "movecache"){
+                size_t megabytes = 1;
+                double millions = 2;
+                command >> megabytes >> millions;
+                move_cache_benchmark(std::max<size_t>(1, megabytes), (U64) (std::max(millions, 0.001) * 1e6));
+                return true;
+            }
+            if(token == "mate"){
+                U64 max_nodes = 10000000;
+                size_t megabytes = 64;
+                command >> max_nodes >> megabytes;
+                mate_benchmark(max_nodes, megabytes);
+                return true;
+            }
+            if(token == "perft") perft = true;
+            else if(token == "counters") counters = true;
+            else depth = std::atoi(token.c_str());
+        }
+        if(perft)
+            perft_benchmark(depth > 0 ? depth : 4, counters);
+        else
+            search_benchmark(depth > 0 ? depth : 7, counters);
+    }else if(token == "dedup"){
+        //dedup <input fens> <output fens> [megabytes] [threads]
+        wait_for_worker();
+        std::string input_path, output_path;
+        size_t megabytes = 256;
+        int threads = searcher.get_threads();
+        command >> input_path >> output_path >> megabytes >> threads;
+        std::ifstream input(input_path);
+        std::ofstream output(output_path);
+        if(!input || !output){
+            uci_send("info string could not open " + (input ? output_path : input_path));
+            return true;
+        }
+        Position_Filter filter(megabytes);
+        dedup_stats stats = dedup_fens(input, output, filter, std::max(1, threads));
+        uci_send("info string " + std::to_string(stats.positions) + " positions, " + std::to_string(stats.duplicates)
+                 + " duplicates, " + std::to_string((U64) (stats.positions / (stats.seconds > 0 ? stats.seconds : 1e-9)))
+                 + " positions/second");
+    }else if(token == "divide"){
+        wait_for_worker();
+        divide(command);
+    }else if(token == "perftstats"){
+        //perftstats <depth> [threads n], leaf moves by kind
+        wait_for_worker();
+        int depth = 1, threads = searcher.get_threads();
+        command >> depth;
+        while(command >> token){
+            if(token == "threads") command >> threads;
+        }
+        Bitboard_Gen root = board;
+        perft_stop.store(false);
+        std::atomic<bool> * stop = &perft_stop;
+        worker = std::thread([root, depth, threads, stop](){
+            auto start = std::chrono::steady_clock::now();
+            perft_stats stats = perft_statistics(root, depth, std::max(1, threads), stop);
+            if(stop->load()){
+                uci_send("info string perftstats stopped");
+                return;
+            }
+            int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            uci_send("nodes " + std::to_string(stats.nodes) + " captures " + std::to_string(stats.captures)
+                     + " ep " + std::to_string(stats.en_passant) + " castles " + std::to_string(stats.castles)
+                     + " promotions " + std::to_string(stats.promotions) + " checks " + std::to_string(stats.checks)
+                     + " discovered " + std::to_string(stats.discovered_checks) + " double " + std::to_string(stats.double_checks)
+                     + " checkmates " + std::to_string(stats.checkmates));
+            uci_send("time " + std::to_string(elapsed) + " ms, " + std::to_string(stats.nodes * 1000 / (elapsed ? elapsed : 1)) + " nps");
+        });
+    }else if(token == "mate"){
+        //mate [nodes n] [plies n] [hash mb], proves or refutes a mate by continuous checks
+        wait_for_worker();
+        U64 max_nodes = 10000000;
+        int max_plies = 0;
+        size_t megabytes = 64;
+        while(command >> token){
+            if(token == "nodes") command >> max_nodes;
+            else if(token == "plies") command >> max_plies;
+            else if(token == "hash") command >> megabytes;
+        }
+        DFPN_Solver solver(megabytes);
+        dfpn_result result = solver.solve(board, max_nodes, max_plies);
+        std::ostringstream line;
+        line << "info string " << (result.status == DFPN_PROVEN ? "mate in " + std::to_string((result.mate_plies + 1) / 2)
+                                   : result.status == DFPN_DISPROVEN ? std::string("no mate by checks") : std::string("unknown"))
+             << " nodes " << result.nodes << " time " << (U64) (result.seconds * 1000)
+             << " nps " << (U64) (result.nodes / (result.seconds > 0 ? result.seconds : 1e-9)) << " pv";
+        for(uint16_t move : result.pv)
+            line << " " << move_to_uci(move);
+        uci_send(line.str());
+    }else if(token == "serve"){
+        //serve <socket path> [threads n] [batch n] [maxperft n] [cache mb], answers queries until a client sends shutdown
+        wait_for_worker();
+        server_options options;
+        options.threads = searcher.get_threads();
+        command >> options.path;
+        while(command >> token){
+            if(token == "threads") command >> options.threads;
+            else if(token == "batch") command >> options.batch_size;
+            else if(token == "maxperft") command >> options.max_perft_depth;
+            else if(token == "cache") command >> options.cache_megabytes;
+        }
+        Query_Server server(options);
+        uci_send("info string serving on " + options.path);
+        if(!server.run()){
+            uci_send("info string could not listen on " + options.path);
+            return true;
+        }
+        server_stats stats = server.stats();
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(1) << "info string " << stats.queries << " queries in " << stats.seconds << " s, "
+             << stats.queries / (stats.seconds > 0 ? stats.seconds : 1e-9) << " queries/s, p50 " << stats.p50_ns / 1000.0
+             << " us, p99 " << stats.p99_ns / 1000.0 << " us";
+        if(options.cache_megabytes)
+            line << ", move cache hit rate " << 100 * stats.cache.hit_rate() << "% with " << stats.cache.entries << " of "
+                 << stats.cache.capacity << " entries, " << stats.cache.evictions << " evictions";
+        uci_send(line.str());
+    }else if(token == "mcts"){
+        wait_for_worker();
+        mcts(command);
+    }else if(token == "sample"){
+        wait_for_worker();
+        sample(command);
+    }else if(token == "selfplay"){
+        wait_for_worker();
+        selfplay(command);
+    }else if(token == "tbgen"){
+        //tbgen <signature> [directory] [threads], builds the table and everything it converts into
+        wait_for_worker();
+        std::string signature, directory = ".";
+        int threads = searcher.get_threads();
+        command >> signature >> directory >> threads;
+        if(!tablebase)
+            tablebase.reset(new Tablebase());
+        if(tablebase->build(signature, directory, std::max(1, threads))){
+            searcher.tablebase = tablebase.get();
+            uci_send("info string built " + signature);
+        }else{
+            uci_send("info string could not build " + signature);
+        }
+    }else if(token == "d"){
+        board.print_board();
+    }else if(token == "quit"){
+        searcher.stop();
+        perft_stop.store(true);
+        wait_for_worker();
+        return false;
+    }else if(!token.empty()){
+        uci_send("info string unknown command " + token);
+    }
+    return true;
+}
+
+void UCI::position(std::istringstream & command){
+    std::string token, fen;
+    command >> token;
+    if(token == "startpos"){
+        fen = UCI_START_FEN;
+        command >> token;
+    }else if(token == "fen"){
+        while(command >> token && token != "moves")
+            fen += token + " ";
+    }else{
+        return;
+    }
+    board.set_board(fen);
+    if(token != "moves")
+        return;
+    while(command >> token){
+        uint16_t move = parse_uci_move(board, token);
+        if(!move){
+            uci_send("info string illegal move " + token);
+            return;
+        }
+        board.make_move(move);
+    }
+}
+
+void UCI::go(std::istringstream & command){
+    search_limits limits;
+    int64_t time_left[2] = {0, 0}, increment[2] = {0, 0};
+    int moves_to_go = 0;
+    bool ponder = false;
+    std::string token;
+    while(command >> token){
+        if(token == "perft"){
+            int depth = 1;
+            command >> depth;
+            Bitboard_Gen root = board;
+            int threads = searcher.get_threads();
+            perft_stop.store(false);
+            std::atomic<bool> * stop = &perft_stop;
+            worker = std::thread([root, depth, threads, stop](){
+                perft_diagnose(root, std::max(1, depth), threads, nullptr, uci_send, stop);
+            });
+            return;
+        }
+        else if(token == "wtime") command >> time_left[WHITE];
+        else if(token == "btime") command >> time_left[BLACK];
+        else if(token == "winc") command >> increment[WHITE];
+        else if(token == "binc") command >> increment[BLACK];
+        else if(token == "movestogo") command >> moves_to_go;
+        else if(token == "movetime") command >> limits.movetime;
+        else if(token == "depth") command >> limits.depth;
+        else if(token == "nodes") command >> limits.nodes;
+        else if(token == "infinite") limits.infinite = true;
+        else if(token == "ponder") ponder = true;
+    }
+    //a book move is played at once, pondering and infinite searches still search
+    if(own_book && !ponder && !limits.infinite){
+        uint16_t move = book.pick(board, (U64) std::chrono::steady_clock::now().time_since_epoch().count());
+        if(move){
+            uci_send("bestmove " + move_to_uci(move));
+            return;
+        }
+    }
+    limits.depth = std::max(1, std::min(limits.depth, MAX_PLY - 1));
+    //spread the clock over the expected number of moves left, keeping a safety margin
+    int side = board.current_side;
+    if(!limits.movetime && time_left[side]){
+        int64_t budget = time_left[side] / (moves_to_go ? moves_to_go + 1 : 30) + increment[side] * 3 / 4;
+        limits.movetime = std::max<int64_t>(1, std::min(budget, time_left[side] - 50));
+    }
+
+    Bitboard_Gen root = board;
+    worker = std::thread([this, root, limits, ponder](){
+        search_result result = searcher.search(root, limits, ponder);
+        std::string line = "bestmove " + move_to_uci(result.best_move);
+        if(result.ponder_move)
+            line += " ponder " + move_to_uci(result.ponder_move);
+        uci_send(line);
+    });
+}
+
+//divide <depth> [threads <n>] [reference <file>] [save <file> [levels]], save keeps 3 levels by default
+void UCI::divide(std::istringstream & command){
+    int depth = 1, threads = searcher.get_threads(), levels = 0;
+    std::string token, reference_path, save_path;
+    command >> depth;
+    while(command >> token){
+        if(token == "threads") command >> threads;
+        else if(token == "reference") command >> reference_path;
+        else if(token == "save"){
+            command >> save_path;
+            if(!(command >> levels)){
+                command.clear();
+                levels = 0;
+            }
+        }
+    }
+    depth = std::max(1, depth);
+    threads = std::max(1, threads);
+    Bitboard_Gen root = board;
+    perft_stop.store(false);
+    std::atomic<bool> * stop = &perft_stop;
+    if(!save_path.empty()){
+        worker = std::thread([root, depth, threads, levels, save_path, stop](){
+            bool saved = save_perft_reference(save_path, root, depth, levels > 0 ? levels : std::min(depth, 3), threads, stop);
+            uci_send("info string " + std::string(saved ? "saved " : stop->load() ? "stopped, did not save " : "could not save ") + save_path);
+        });
+        return;
+    }
+    std::shared_ptr<std::map<std::string, U64>> reference;
+    if(!reference_path.empty()){
+        reference.reset(new std::map<std::string, U64>());
+        if(!load_perft_reference(reference_path, *reference)){
+            uci_send("info string could not read " + reference_path);
+            return;
+        }
+    }
+    worker = std::thread([root, depth, threads, reference, stop](){
+        perft_diagnose(root, depth, threads, reference.get(), uci_send, stop);
+    });
+}
+
+//selfplay <games> [threads n] [depth d] [nodes n] [hash mb] [maxplies n] [book file] [random n] [seed n] [out file]
+void UCI::selfplay(std::istringstream & command){
+    selfplay_options options;
+    options.threads = searcher.get_threads();
+    options.limits.depth = 4;
+    std::string token;
+    command >> options.games;
+    while(command >> token){
+        if(token == "threads") command >> options.threads;
+        else if(token == "depth") command >> options.limits.depth;
+        else if(token == "nodes") command >> options.limits.nodes;
+        else if(token == "hash") command >> options.hash_megabytes;
+        else if(token == "maxplies") command >> options.max_plies;
+        else if(token == "book") command >> options.book_path;
+        else if(token == "random") command >> options.random_plies;
+        else if(token == "seed") command >> options.seed;
+        else if(token == "out") command >> options.output_path;
+    }
+    options.threads = std::max(1, options.threads);
+    options.limits.depth = std::max(1, std::min(options.limits.depth, 64));
+    options.max_plies = std::max(1, std::min(options.max_plies, 300));
+    options.random_plies = std::max(0, std::min(options.random_plies, options.max_plies));
+    int report_every = std::max(1, options.games / 20);
+    auto summary = [](const selfplay_stats & stats){
+        double seconds = stats.seconds > 0 ? stats.seconds : 1e-9;
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(2) << stats.games << " games, +" << stats.results[SELFPLAY_WHITE_WINS]
+             << " -" << stats.results[SELFPLAY_BLACK_WINS] << " =" << stats.results[SELFPLAY_DRAW]
+             << ", " << stats.games / seconds << " games/s, " << stats.plies / seconds << " plies/s";
+        return line.str();
+    };
+    selfplay_stats stats = run_selfplay(options, [&](const selfplay_stats & progress){
+        if(progress.games % report_every == 0)
+            uci_send("info string " + summary(progress));
+    });
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1) << summary(stats) << ", mate " << stats.reasons[ADJUDICATE_CHECKMATE]
+         << " stalemate " << stats.reasons[ADJUDICATE_STALEMATE] << " repetition " << stats.reasons[ADJUDICATE_REPETITION]
+         << " fifty " << stats.reasons[ADJUDICATE_FIFTY_MOVES] << " material " << stats.reasons[ADJUDICATE_MATERIAL]
+         << " maxplies " << stats.reasons[ADJUDICATE_MAX_PLIES];
+    if(stats.cpu_seconds > 0)
+        line << ", cpu " << 100 * stats.cpu_seconds / ((stats.seconds > 0 ? stats.seconds : 1e-9) * options.threads)
+             << "% of " << options.threads << " threads";
+    uci_send("info string " + line.str());
+}
+
+//sample <positions> [threads n] [minply n] [maxply n] [nocheck] [quiet] [captureweight n] [stride n] [seed n] [book file] [out file]
+void UCI::sample(std::istringstream & command){
+    sampler_options options;
+    options.threads = searcher.get_threads();
+    std::string token, output_path = "samples.bin";
+    command >> options.positions;
+    while(command >> token){
+        if(token == "threads") command >> options.threads;
+        else if(token == "minply") command >> options.min_ply;
+        else if(token == "maxply") command >> options.max_ply;
+        else if(token == "nocheck") options.skip_in_check = true;
+        else if(token == "quiet") options.skip_hanging = true;
+        else if(token == "captureweight") command >> options.capture_weight;
+        else if(token == "stride") command >> options.stride;
+        else if(token == "seed") command >> options.seed;
+        else if(token == "out") command >> output_path;
+        else if(token == "book"){
+            command >> token;
+            if(!load_epd_book(token, options.seeds))
+                uci_send("info string could not read " + token + ", sampling from the start position");
+        }
+    }
+    options.threads = std::max(1, options.threads);
+    options.stride = std::max(0, options.stride);
+    options.seed = options.seed ? options.seed : 1;
+    std::ofstream out(output_path, std::ios::binary);
+    if(!out){
+        uci_send("info string could not open " + output_path);
+        return;
+    }
+    sampler_stats stats = sample_positions(options, out);
+    double seconds = stats.seconds > 0 ? stats.seconds : 1e-9;
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(0) << stats.positions << " positions from " << stats.playouts << " playouts in "
+         << std::setprecision(2) << stats.seconds << " s, " << std::setprecision(0) << stats.positions / seconds
+         << " positions/s, " << stats.positions / seconds / options.threads << " per thread, "
+         << stats.plies / seconds << " plies/s";
+    uci_send("info string " + line.str());
+}
+
+//mcts [playouts n] [movetime ms] [threads n] [batch n] [memory mb], runs to completion before answering
+void UCI::mcts(std::istringstream & command){
+    mcts_limits limits;
+    limits.threads = searcher.get_threads();
+    size_t megabytes = 256;
+    std::string token;
+    while(command >> token){
+        if(token == "playouts") command >> limits.playouts;
+        else if(token == "movetime") command >> limits.movetime;
+        else if(token == "threads") command >> limits.threads;
+        else if(token == "batch") command >> limits.batch_size;
+        else if(token == "memory") command >> megabytes;
+    }
+    limits.threads = std::max(1, limits.threads);
+    if(!mcts_search || mcts_megabytes != megabytes){
+        mcts_search.reset(new MCTS_Search(megabytes));
+        mcts_megabytes = megabytes;
+    }
+    mcts_result result = mcts_search->search(board, limits);
+    for(size_t i = 0; i < std::min<size_t>(result.root_children.size(), 5); i++){
+        const mcts_child_info & child = result.root_children[i];
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(3) << "info string " << move_to_uci(child.move)
+             << " visits " << child.visits << " value " << child.value;
+        uci_send(line.str());
+    }
+    std::ostringstream line;
+    double seconds = result.time > 0 ? result.time / 1000.0 : 1e-3;
+    line << "info string playouts " << result.playouts << " time " << result.time << " playouts/s "
+         << (U64) (result.playouts / seconds) << " nodes " << result.nodes << " bytes/node " << result.bytes_per_node
+         << " memory " << result.nodes * result.bytes_per_node / 1024 << " kB" << (result.pool_full ? " (pool full)" : "") << " pv";
+    for(uint16_t move : result.pv)
+        line << " " << move_to_uci(move);
+    uci_send(line.str());
+    uci_send("bestmove " + move_to_uci(result.best_move));
+}
+
+void UCI::setoption(std::istringstream & command){
+    std::string token, name, value;
+    command >> token;
+    while(command >> token && token != "value")
+        name += (name.empty() ? "" : " ") + token;
+    while(command >> token)
+        value += (value.empty() ? "" : " ") + token;
+
+    int number = 0;
+    if((name == "Hash" || name == "Threads") && !parse_spin(value, 1, name == "Hash" ? 65536 : 256, number)){
+        uci_send("info string " + name + " needs a number, not " + (value.empty() ? "nothing" : value));
+    }else if(name == "Hash"){
+        size_t previous = searcher.tt.megabytes();
+        try{
+            searcher.set_hash(number);
+        }catch(const std::bad_alloc &){
+            searcher.set_hash(previous);
+            uci_send("info string could not allocate " + std::to_string(number) + " MB of hash, keeping " + std::to_string(previous));
+        }
+    }else if(name == "Threads"){
+        searcher.set_threads(number);
+        //first touch the table again from as many threads as will search it
+        searcher.clear();
+    }else if(name == "LargePages"){
+        set_large_pages(value == "true");
+        searcher.set_hash(searcher.tt.megabytes());
+        uci_send(std::string("info string hash on ") + searcher.tt.page_kind_name());
+    }else if(name == "Clear Hash"){
+        searcher.clear();
+    }else if(name == "EvalFile"){
+        network.reset(new NNUE_Network());
+        if(value != "<empty>" && network->load(value)){
+            searcher.set_network(network.get());
+            uci_send("info string loaded network " + value);
+        }else{
+            searcher.set_network(nullptr);
+            network.reset();
+            if(value != "<empty>")
+                uci_send("info string could not load network " + value);
+        }
+    }else if(name == "TablebasePath"){
+        tablebase.reset(new Tablebase());
+        int loaded = value != "<empty>" ? tablebase->load_directory(value) : 0;
+        searcher.tablebase = loaded ? tablebase.get() : nullptr;
+        if(!loaded)
+            tablebase.reset();
+        uci_send("info string loaded " + std::to_string(loaded) + " tables");
+    }else if(name == "OwnBook"){
+        own_book = value == "true";
+    }else if(name == "BookFile"){
+        if(value == "<empty>")
+            book.close();
+        else
+            uci_send("info string " + std::string(book.open(value) ? "opened book " : "could not open book ") + value);
+    }
+}
+
+void UCI::wait_for_worker(){
+    if(worker.joinable())
+        worker.join();
+}
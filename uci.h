@@ -0,0 +1,63 @@
+//
+//  uci.h
+//  InvincibleSummer
+//
+//  UCI protocol driver. Searches and perft/divide run on a background thread so the
+//  stdin reader can answer isready/stop/ponderhit while they are running.
+//
+#include "bitboard_gen.h"
+#include "search.h"
+#include "nnue.h"
+#include "polyglot.h"
+#include "mcts.h"
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifndef UCI_DRIVER
+#define UCI_DRIVER
+
+#define UCI_START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+std::string move_to_uci(uint16_t move);
+//returns 0 if the text is not a legal move in the position
+uint16_t parse_uci_move(Bitboard_Gen & board, const std::string & text);
+
+//writes a whole line at once so the reader and search threads never interleave
+void uci_send(const std::string & line);
+
+class UCI{
+public:
+    UCI();
+    ~UCI();
+    void loop(std::istream & in);
+    //runs one command, returns false on quit
+    bool execute(const std::string & line);
+    void wait_for_worker();
+
+private:
+    Bitboard_Gen board;
+    Searcher searcher;
+    std::unique_ptr<NNUE_Network> network;
+    std::unique_ptr<Tablebase> tablebase;
+    std::unique_ptr<MCTS_Search> mcts_search;
+    size_t mcts_megabytes = 0;
+    Polyglot_Book book;
+    bool own_book = false;
+    std::thread worker;
+    //set by stop and quit, perft, divide and perftstats check it between moves
+    std::atomic<bool> perft_stop{false};
+
+    void position(std::istringstream & command);
+    void go(std::istringstream & command);
+    void divide(std::istringstream & command);
+    void selfplay(std::istringstream & command);
+    void sample(std::istringstream & command);
+    void mcts(std::istringstream & command);
+    void setoption(std::istringstream & command);
+};
+
+#endif
@@ -5,6 +5,10 @@
 //  Created by Harry Chiu on 10/27/24.
 //
 #include <cassert>
+#include <cstdint>
+
+#ifndef UTILITY
+#define UTILITY
 
 // xorshift64star Pseudo-Random Number Generator
 // This class is based on original code written and dedicated
@@ -52,3 +56,5 @@ class PRNG {
         return T(rand64() & rand64() & rand64());
     }
 };
+
+#endif